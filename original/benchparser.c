@@ -0,0 +1,51 @@
+/* benchparser.c -- a quiet run of the ini file parser for timing */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ckparser.h"
+
+/* the callback only counts, so that what is timed is the parse and
+ * not the printing. */
+
+long pairs = 0;
+
+int
+cb_count(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	pairs += 1;
+	return 0;
+}
+
+/*
+ * bench driver.
+ *
+ * benchparser file
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	FILE *file = fopen(argv[1], "r");
+	if (!file) {
+		printf("error coult not open file %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	parse_ini(file, NULL, cb_count);
+	fclose(file);
+	printf("%ld pairs\n", pairs);
+	return EXIT_SUCCESS;
+}
+
+/* benchparser.c ends here */
@@ -0,0 +1,113 @@
+#!/bin/sh
+# benchini.sh -- time the workthru and original parsers on one corpus
+#
+# sh benchini.sh [megabytes] [runs]
+#
+# builds each parser with optimization into a scratch directory,
+# generates a corpus of about 'megabytes' (default 50), and runs every
+# parser 'runs' times (default 5) on it, reporting the best wall time
+# and throughput. every parser only counts pairs, and the script
+# fails if the counts disagree.
+#
+# the pascal parser prints every pair and has no quiet mode, so it
+# isn't timed here. it has no block scanner either; that is still to
+# be written, and belongs in this script's timing and pair count
+# check once it compiles.
+#
+# the corpus keeps keys under 64 characters and values under 1024 so
+# that original/ckparser.c handles it too.
+
+set -e
+
+MB=${1:-50}
+RUNS=${2:-5}
+HERE=$(cd "$(dirname "$0")" && pwd)
+TOP=$(dirname "$HERE")
+WORK=${TMPDIR:-/tmp}/benchini.$$
+CC=${CC:-cc}
+
+mkdir -p "$WORK"
+trap 'rm -rf "$WORK"' EXIT
+
+# the parser's modules are whatever INI_SOURCES lists in the workthru
+# CMakeLists.txt, so a new module doesn't break the build here.
+SOURCES=$(sed -n 's/^set(INI_SOURCES \(.*\))$/\1/p' "$TOP/workthru/CMakeLists.txt" |
+	tr -d '"' | tr ' ' '\n' | sed -n "s|^\(.*\.c\)$|$TOP/workthru/\1|p")
+if [ -z "$SOURCES" ]; then
+	echo "no INI_SOURCES in $TOP/workthru/CMakeLists.txt" >&2
+	exit 1
+fi
+
+echo "building in $WORK"
+$CC -O2 -std=gnu18 -o "$WORK/ckparser" \
+	"$TOP/original/benchparser.c" "$TOP/original/ckparser.c"
+$CC -O2 -std=gnu18 -I"$TOP/workthru" -o "$WORK/workthru" \
+	"$TOP/workthru/benchparser.c" "$TOP/workthru/inicompress.c" $SOURCES
+
+echo "generating a ${MB}MB corpus"
+awk -v mb="$MB" 'BEGIN {
+	srand(31)
+	limit = mb * 1024 * 1024
+	while (size < limit) {
+		line = sprintf("[section_%d]", s++)
+		print line
+		size += length(line) + 1
+		n = 5 + int(rand() * 40)
+		for (k = 0; k < n; k++) {
+			if (rand() < 0.1) {
+				line = "; a comment about key " k
+			} else {
+				value = ""
+				w = 1 + int(rand() * 12)
+				for (i = 0; i < w; i++)
+					value = value sprintf("word%d ", int(rand() * 100000))
+				if (rand() < 0.5)
+					line = sprintf("key_%d = %s", k, value)
+				else
+					line = sprintf("  key_%d=%s", k, value)
+			}
+			print line
+			size += length(line) + 1
+		}
+		print ""
+		size += 1
+	}
+}' > "$WORK/corpus.ini"
+BYTES=$(wc -c < "$WORK/corpus.ini")
+
+# best_of name command...
+best_of() {
+	name=$1
+	shift
+	best=
+	for r in $(seq "$RUNS"); do
+		start=$(date +%s%N)
+		out=$("$@" | grep pairs)
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+			best=$ms
+		fi
+	done
+	[ "$best" -gt 0 ] || best=1
+	awk -v n="$name" -v b="$BYTES" -v ms="$best" -v out="$out" 'BEGIN {
+		printf "%-24s %8d ms %8.1f MB/s   %s\n", n, ms, b / ms / 1000, out
+	}'
+	count=${out%% pairs*}
+	if [ -z "$PAIRS" ]; then
+		PAIRS=$count
+	elif [ "$count" != "$PAIRS" ]; then
+		echo "pair counts disagree: $count against $PAIRS" >&2
+		FAILED=1
+	fi
+}
+
+PAIRS=
+FAILED=
+
+echo
+best_of "original ckparser.c" "$WORK/ckparser" "$WORK/corpus.ini"
+best_of "workthru iniparser.c" "$WORK/workthru" "$WORK/corpus.ini" once
+[ -z "$FAILED" ] || exit 1
+
+# benchini.sh ends here
@@ -0,0 +1,207 @@
+/* benchparser.c -- time the ini file parser */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "inicompress.h"
+#include "iniparser.h"
+
+/*
+ * the callback counts pairs and bytes so that every way of reading
+ * the file can be checked against the others, and so the compiler
+ * can't decide the parse does nothing.
+ */
+
+typedef struct tally {
+	size_t pairs;
+	size_t bytes;
+} tally;
+
+bool
+cb_count(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	tally *t = ctx;
+	t->pairs += 1;
+	t->bytes += strlen(section) + strlen(key) + strlen(value);
+	return false;
+}
+
+double
+now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * decompress_then_parse
+ *
+ * the old way: inflate the whole file into a temporary file, then
+ * parse that.
+ *
+ * return: bytes of plain text, or -1 on error
+ */
+
+long
+decompress_then_parse(
+	FILE *file,
+	tally *t
+) {
+	ini_zreader *z = ini_zreader_open(file, false);
+	FILE *tmp = tmpfile();
+	if (z == NULL || tmp == NULL) {
+		if (z != NULL)
+			ini_zreader_close(z);
+		if (tmp != NULL)
+			fclose(tmp);
+		return -1;
+	}
+	static char buffer[65536];
+	long total = 0;
+	long got;
+	while ((got = ini_zreader_read(z, buffer, sizeof(buffer))) > 0) {
+		if (fwrite(buffer, 1, got, tmp) != (size_t)got) {
+			got = -1;
+			break;
+		}
+		total += got;
+	}
+	ini_zreader_close(z);
+	if (got < 0 || fflush(tmp) != 0) {
+		fclose(tmp);
+		return -1;
+	}
+	rewind(tmp);
+	int status = parse_ini(tmp, t, cb_count);
+	fclose(tmp);
+	return status == EXIT_SUCCESS ? total : -1;
+}
+
+/*
+ * stream_parse
+ *
+ * the new way: decompress straight into the parser, on one thread
+ * or two.
+ */
+
+int
+stream_parse(
+	FILE *file,
+	bool threaded,
+	tally *t
+) {
+	ini_zreader *z = ini_zreader_open(file, threaded);
+	if (z == NULL)
+		return EXIT_FAILURE;
+	int status = parse_ini_reader(ini_zreader_read, z, t, cb_count, NULL);
+	if (ini_zreader_error(z) != NULL)
+		printf("reader error: %s\n", ini_zreader_error(z));
+	ini_zreader_close(z);
+	return status;
+}
+
+/*
+ * bench driver.
+ *
+ * benchparser file [repeat|once]
+ *
+ * parse the file (plain, gzip, or zstd) each way, 'repeat' times,
+ * and report the best time and throughput in plain text bytes.
+ *
+ * 'once' streams the file through the parser a single time and
+ * reports the pair count, for timing from outside against other
+ * parsers.
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	if (argc > 2 && strcmp(argv[2], "once") == 0) {
+		FILE *file = fopen(argv[1], "rb");
+		if (!file) {
+			printf("error coult not open file %s\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+		tally t = { 0 };
+		int status = stream_parse(file, false, &t);
+		fclose(file);
+		printf("%zu pairs\n", t.pairs);
+		return status;
+	}
+	int repeat = argc > 2 ? atoi(argv[2]) : 5;
+	if (repeat < 1)
+		repeat = 1;
+
+	const char *modes[] = {
+		"decompress then parse", "streaming", "streaming, 2 threads"
+	};
+	double best[3] = { 0 };
+	tally tallies[3] = { { 0 } };
+	long plain = 0;
+	int format = INI_Z_PLAIN;
+
+	for (int r = 0; r < repeat; r++) {
+		for (int m = 0; m < 3; m++) {
+			FILE *file = fopen(argv[1], "rb");
+			if (!file) {
+				printf("error coult not open file %s\n", argv[1]);
+				return EXIT_FAILURE;
+			}
+			if (m == 0 && r == 0) {
+				ini_zreader *z = ini_zreader_open(file, false);
+				format = z ? ini_zreader_format(z) : INI_Z_PLAIN;
+				ini_zreader_close(z);
+				rewind(file);
+			}
+			tally t = { 0 };
+			double start = now();
+			int status = EXIT_SUCCESS;
+			if (m == 0) {
+				plain = decompress_then_parse(file, &t);
+				if (plain < 0)
+					status = EXIT_FAILURE;
+			} else
+				status = stream_parse(file, m == 2, &t);
+			double elapsed = now() - start;
+			fclose(file);
+			if (status != EXIT_SUCCESS) {
+				printf("%s failed, check input file\n", modes[m]);
+				return EXIT_FAILURE;
+			}
+			if (r == 0 || elapsed < best[m])
+				best[m] = elapsed;
+			tallies[m] = t;
+		}
+	}
+
+	const char *formats[] = { "plain", "gzip", "zstd" };
+	printf("%s, %ld bytes of text, %zu pairs\n\n", formats[format], plain,
+		tallies[0].pairs);
+	int status = EXIT_SUCCESS;
+	for (int m = 0; m < 3; m++) {
+		printf("%-24s %8.2f ms %8.1f MB/s", modes[m], best[m] * 1e3,
+			plain / best[m] / 1e6);
+		if (tallies[m].pairs != tallies[0].pairs
+			|| tallies[m].bytes != tallies[0].bytes) {
+			printf("  MISMATCH %zu pairs", tallies[m].pairs);
+			status = EXIT_FAILURE;
+		}
+		printf("\n");
+	}
+	return status;
+}
+
+/* benchparser.c ends here */
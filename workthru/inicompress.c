@@ -0,0 +1,499 @@
+/* inicompress.c -- read gzip or zstd compressed ini files */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef INI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef INI_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef INI_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#include "inicompress.h"
+
+/*
+ * the compressed input is read from the file in blocks of ZIN_BUFLEN.
+ * decompress writes as much output as will fit in the buffer it is
+ * given, which for the single threaded reader is the parser's own
+ * scan buffer.
+ *
+ * the threaded reader runs decompress on its own thread into a ring
+ * of ZBLOCKS blocks of ZBLOCK_LEN bytes. the parser side copies out
+ * of the oldest filled block and hands it back when it is empty.
+ */
+
+#define ZIN_BUFLEN  65536
+#define ZBLOCK_LEN  65536
+#define ZBLOCKS     4
+
+typedef struct zblock {
+	long len;            /* bytes, 0 at end, negative on error */
+	char data[ZBLOCK_LEN];
+} zblock;
+
+struct ini_zreader {
+	FILE *file;
+	int format;
+	bool done;           /* all output delivered  */
+	const char *error;
+
+	unsigned char in[ZIN_BUFLEN];
+	size_t in_pos;
+	size_t in_len;
+	bool in_eof;
+
+#ifdef INI_HAVE_ZLIB
+	z_stream zs;
+	bool zs_ready;
+#endif
+#ifdef INI_HAVE_ZSTD
+	ZSTD_DCtx *zd;
+	size_t zd_pending;   /* nonzero while inside a frame */
+#endif
+
+	bool threaded;
+#ifdef INI_HAVE_THREADS
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+	pthread_cond_t emptied;
+	bool stop;
+	size_t head;         /* oldest filled block      */
+	size_t count;        /* number of filled blocks  */
+	size_t take;         /* bytes used of head block */
+	zblock blocks[ZBLOCKS];
+#endif
+};
+
+/*
+ * fill_input
+ *
+ * make sure there is unused compressed input, reading another block
+ * from the file if needed.
+ *
+ * return: true if there is input
+ */
+
+static
+bool
+fill_input(
+	ini_zreader *z
+) {
+	if (z->in_pos < z->in_len)
+		return true;
+	if (z->in_eof)
+		return false;
+	z->in_pos = 0;
+	z->in_len = fread(z->in, 1, ZIN_BUFLEN, z->file);
+	if (z->in_len == 0) {
+		z->in_eof = true;
+		if (ferror(z->file))
+			z->error = "read error";
+	}
+	return z->in_len > 0;
+}
+
+/*
+ * decompress_plain
+ *
+ * no compression. hand over anything left from the sniff, then read
+ * the file straight into the output.
+ */
+
+static
+long
+decompress_plain(
+	ini_zreader *z,
+	char *out,
+	size_t outlen
+) {
+	if (z->in_pos < z->in_len) {
+		size_t n = z->in_len - z->in_pos;
+		if (n > outlen)
+			n = outlen;
+		memcpy(out, z->in + z->in_pos, n);
+		z->in_pos += n;
+		return n;
+	}
+	size_t n = fread(out, 1, outlen, z->file);
+	if (n == 0 && ferror(z->file)) {
+		z->error = "read error";
+		return -1;
+	}
+	return n;
+}
+
+#ifdef INI_HAVE_ZLIB
+
+/*
+ * decompress_gzip
+ *
+ * inflate until the output is full or the input ends. a file may
+ * hold several gzip members one after the other, as 'cat a.gz b.gz'
+ * produces, so at the end of a member inflate is reset if there is
+ * more input.
+ */
+
+static
+long
+decompress_gzip(
+	ini_zreader *z,
+	char *out,
+	size_t outlen
+) {
+	z_stream *zs = &z->zs;
+	zs->next_out = (Bytef *)out;
+	zs->avail_out = outlen;
+
+	while (zs->avail_out > 0) {
+		if (!fill_input(z)) {
+			if (z->error != NULL)
+				return -1;
+			if (zs->total_in > 0) {
+				z->error = "truncated gzip stream";
+				return -1;
+			}
+			break;
+		}
+		zs->next_in = z->in + z->in_pos;
+		zs->avail_in = z->in_len - z->in_pos;
+		int rc = inflate(zs, Z_NO_FLUSH);
+		z->in_pos = z->in_len - zs->avail_in;
+		if (rc == Z_STREAM_END) {
+			inflateReset(zs);
+			zs->total_in = 0;
+			if (!fill_input(z)) {
+				if (z->error != NULL)
+					return -1;
+				break;
+			}
+			continue;
+		}
+		if (rc != Z_OK && rc != Z_BUF_ERROR) {
+			z->error = zs->msg ? zs->msg : "gzip data error";
+			return -1;
+		}
+	}
+	return outlen - zs->avail_out;
+}
+
+#endif
+
+#ifdef INI_HAVE_ZSTD
+
+/*
+ * decompress_zstd
+ *
+ * ZSTD_decompressStream crosses frame boundaries on its own. it
+ * returns 0 when a frame is complete, otherwise a hint of how much
+ * more input it wants.
+ */
+
+static
+long
+decompress_zstd(
+	ini_zreader *z,
+	char *out,
+	size_t outlen
+) {
+	ZSTD_outBuffer ob = { out, outlen, 0 };
+
+	while (ob.pos < ob.size) {
+		if (!fill_input(z)) {
+			if (z->error != NULL)
+				return -1;
+			if (z->zd_pending != 0) {
+				/* the input is used up but the frame may
+				 * still have output buffered. */
+				ZSTD_inBuffer empty = { z->in, 0, 0 };
+				size_t before = ob.pos;
+				z->zd_pending = ZSTD_decompressStream(z->zd, &ob, &empty);
+				if (ZSTD_isError(z->zd_pending)) {
+					z->error = ZSTD_getErrorName(z->zd_pending);
+					return -1;
+				}
+				if (ob.pos > before)
+					continue;
+				if (z->zd_pending != 0) {
+					z->error = "truncated zstd stream";
+					return -1;
+				}
+			}
+			break;
+		}
+		ZSTD_inBuffer ib = { z->in, z->in_len, z->in_pos };
+		z->zd_pending = ZSTD_decompressStream(z->zd, &ob, &ib);
+		z->in_pos = ib.pos;
+		if (ZSTD_isError(z->zd_pending)) {
+			z->error = ZSTD_getErrorName(z->zd_pending);
+			return -1;
+		}
+	}
+	return ob.pos;
+}
+
+#endif
+
+/*
+ * decompress
+ *
+ * fill 'out' with the next run of plain text.
+ *
+ * return: bytes produced, 0 at end, negative on error
+ */
+
+static
+long
+decompress(
+	ini_zreader *z,
+	char *out,
+	size_t outlen
+) {
+	if (z->done)
+		return 0;
+	if (z->error != NULL)
+		return -1;
+
+	long got = -1;
+	switch (z->format) {
+	case INI_Z_PLAIN:
+		got = decompress_plain(z, out, outlen);
+		break;
+#ifdef INI_HAVE_ZLIB
+	case INI_Z_GZIP:
+		got = decompress_gzip(z, out, outlen);
+		break;
+#endif
+#ifdef INI_HAVE_ZSTD
+	case INI_Z_ZSTD:
+		got = decompress_zstd(z, out, outlen);
+		break;
+#endif
+	default:
+		z->error = "compression format not supported in this build";
+		break;
+	}
+	if (got == 0)
+		z->done = true;
+	return got;
+}
+
+#ifdef INI_HAVE_THREADS
+
+/*
+ * produce
+ *
+ * the decompression thread. fill free blocks until the end of the
+ * input, an error, or the reader is closed. the end and errors are
+ * passed along as a block with len <= 0.
+ */
+
+static
+void *
+produce(
+	void *arg
+) {
+	ini_zreader *z = arg;
+	for (;;) {
+		pthread_mutex_lock(&z->lock);
+		while (z->count == ZBLOCKS && !z->stop)
+			pthread_cond_wait(&z->emptied, &z->lock);
+		if (z->stop) {
+			pthread_mutex_unlock(&z->lock);
+			return NULL;
+		}
+		zblock *b = &z->blocks[(z->head + z->count) % ZBLOCKS];
+		pthread_mutex_unlock(&z->lock);
+
+		/* only this thread touches a free block, so the work
+		 * is done without the lock. */
+
+		b->len = decompress(z, b->data, ZBLOCK_LEN);
+
+		pthread_mutex_lock(&z->lock);
+		z->count += 1;
+		pthread_cond_signal(&z->filled);
+		pthread_mutex_unlock(&z->lock);
+		if (b->len <= 0)
+			return NULL;
+	}
+}
+
+/*
+ * consume
+ *
+ * copy from the oldest filled block into the parser's buffer.
+ */
+
+static
+long
+consume(
+	ini_zreader *z,
+	char *buffer,
+	size_t buflen
+) {
+	pthread_mutex_lock(&z->lock);
+	while (z->count == 0)
+		pthread_cond_wait(&z->filled, &z->lock);
+	zblock *b = &z->blocks[z->head];
+	pthread_mutex_unlock(&z->lock);
+
+	if (b->len <= 0)
+		return b->len;  /* left in place, every later read sees it */
+
+	size_t n = b->len - z->take;
+	if (n > buflen)
+		n = buflen;
+	memcpy(buffer, b->data + z->take, n);
+	z->take += n;
+
+	if (z->take == (size_t)b->len) {
+		pthread_mutex_lock(&z->lock);
+		z->head = (z->head + 1) % ZBLOCKS;
+		z->count -= 1;
+		z->take = 0;
+		pthread_cond_signal(&z->emptied);
+		pthread_mutex_unlock(&z->lock);
+	}
+	return n;
+}
+
+#endif
+
+/*
+ * sniff
+ *
+ * pick the format from the magic number at the front of the input.
+ *
+ * gzip: 1f 8b
+ * zstd: 28 b5 2f fd
+ */
+
+static
+int
+sniff(
+	ini_zreader *z
+) {
+	if (!fill_input(z))
+		return INI_Z_PLAIN;
+	const unsigned char *p = z->in;
+	size_t n = z->in_len;
+	if (n >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+		return INI_Z_GZIP;
+	if (n >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+		return INI_Z_ZSTD;
+	return INI_Z_PLAIN;
+}
+
+ini_zreader *
+ini_zreader_open(
+	FILE *file,
+	bool threaded
+) {
+	ini_zreader *z = calloc(1, sizeof(ini_zreader));
+	if (z == NULL)
+		return NULL;
+	z->file = file;
+	z->format = sniff(z);
+
+#ifdef INI_HAVE_ZLIB
+	if (z->format == INI_Z_GZIP) {
+		/* 15 bits of window, +16 for a gzip header. */
+		if (inflateInit2(&z->zs, 15 + 16) != Z_OK) {
+			free(z);
+			return NULL;
+		}
+		z->zs_ready = true;
+	}
+#endif
+#ifdef INI_HAVE_ZSTD
+	if (z->format == INI_Z_ZSTD) {
+		z->zd = ZSTD_createDCtx();
+		if (z->zd == NULL) {
+			free(z);
+			return NULL;
+		}
+	}
+#endif
+
+#ifdef INI_HAVE_THREADS
+	if (threaded) {
+		pthread_mutex_init(&z->lock, NULL);
+		pthread_cond_init(&z->filled, NULL);
+		pthread_cond_init(&z->emptied, NULL);
+		if (pthread_create(&z->thread, NULL, produce, z) != 0) {
+			pthread_mutex_destroy(&z->lock);
+			pthread_cond_destroy(&z->filled);
+			pthread_cond_destroy(&z->emptied);
+			ini_zreader_close(z);
+			return NULL;
+		}
+		z->threaded = true;
+	}
+#endif
+	return z;
+}
+
+long
+ini_zreader_read(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	ini_zreader *z = handle;
+#ifdef INI_HAVE_THREADS
+	if (z->threaded)
+		return consume(z, buffer, buflen);
+#endif
+	return decompress(z, buffer, buflen);
+}
+
+int
+ini_zreader_format(
+	const ini_zreader *z
+) {
+	return z->format;
+}
+
+const char *
+ini_zreader_error(
+	const ini_zreader *z
+) {
+	return z->error;
+}
+
+void
+ini_zreader_close(
+	ini_zreader *z
+) {
+	if (z == NULL)
+		return;
+#ifdef INI_HAVE_THREADS
+	if (z->threaded) {
+		pthread_mutex_lock(&z->lock);
+		z->stop = true;
+		pthread_cond_signal(&z->emptied);
+		pthread_mutex_unlock(&z->lock);
+		pthread_join(z->thread, NULL);
+		pthread_mutex_destroy(&z->lock);
+		pthread_cond_destroy(&z->filled);
+		pthread_cond_destroy(&z->emptied);
+	}
+#endif
+#ifdef INI_HAVE_ZLIB
+	if (z->zs_ready)
+		inflateEnd(&z->zs);
+#endif
+#ifdef INI_HAVE_ZSTD
+	ZSTD_freeDCtx(z->zd);
+#endif
+	free(z);
+}
+
+/* inicompress.c ends here */
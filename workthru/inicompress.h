@@ -0,0 +1,84 @@
+/* inicompress.h -- read gzip or zstd compressed ini files */
+
+#ifndef INICOMPRESS_H
+#define INICOMPRESS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "iniparser.h"
+
+/*
+ * a reader for parse_ini_reader that looks at the first bytes of a
+ * stream and, if they are a gzip or zstd magic number, decompresses
+ * block by block into the parser's scan buffer. anything else is
+ * passed through as plain text. there is no temporary file and the
+ * whole of the input is never in memory at once.
+ *
+ *   ini_zreader *z = ini_zreader_open(file, false);
+ *   parse_ini_reader(ini_zreader_read, z, ctx, callback, NULL);
+ *   ini_zreader_close(z);
+ *
+ * gzip support needs zlib (INI_HAVE_ZLIB) and zstd support needs
+ * libzstd (INI_HAVE_ZSTD). a compressed stream whose format was not
+ * built in fails on the first read.
+ *
+ * if 'threaded' is set (and INI_HAVE_THREADS was built in), a second
+ * thread decompresses a few blocks ahead of the parser so the two
+ * overlap. the blocks are copied into the scan buffer as the parser
+ * asks for them.
+ */
+
+#define INI_Z_PLAIN 0
+#define INI_Z_GZIP  1
+#define INI_Z_ZSTD  2
+
+typedef struct ini_zreader ini_zreader;
+
+/*
+ * ini_zreader_open
+ *
+ * in/out: file stream, positioned at the start of the data. it is
+ *         not closed by ini_zreader_close.
+ * in    : run the decompression on its own thread
+ * return: the reader or NULL if memory is exhausted or the thread
+ *         could not be started
+ */
+
+ini_zreader *
+ini_zreader_open(
+	FILE *file,
+	bool threaded
+);
+
+/* the fn_reader to hand to parse_ini_reader. */
+
+long
+ini_zreader_read(
+	void *handle,
+	char *buffer,
+	size_t buflen
+);
+
+/* INI_Z_PLAIN, INI_Z_GZIP, or INI_Z_ZSTD as detected. */
+
+int
+ini_zreader_format(
+	const ini_zreader *z
+);
+
+/* why the last read failed, or NULL. */
+
+const char *
+ini_zreader_error(
+	const ini_zreader *z
+);
+
+void
+ini_zreader_close(
+	ini_zreader *z
+);
+
+#endif /* INICOMPRESS_H */
+
+/* inicompress.h ends here */
@@ -0,0 +1,258 @@
+/* inidupes.c -- duplicate section and key handling for the parser */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inidupes.h"
+#include "inihash.h"
+
+/*
+ * sections are kept in an ini_table by name, and each section has
+ * its own ini_table of the keys seen in it. the order arrays of the
+ * tables give the delivery order for the held policies.
+ */
+
+typedef struct dkey {
+	ini_named n;
+	char *value;        /* held policies only */
+	size_t len;
+} dkey;
+
+typedef struct dsec {
+	ini_named n;
+	ini_table keys;
+} dsec;
+
+struct ini_dupes {
+	int policy;
+	char separator;
+	ini_table sections;
+	dsec *current;      /* most recent section, the usual hit */
+};
+
+static
+char *
+copy_string(
+	const char *s,
+	size_t len
+) {
+	char *p = malloc(len + 1);
+	if (p != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return p;
+}
+
+ini_dupes *
+ini_dupes_create(
+	int policy,
+	char separator
+) {
+	switch (policy) {
+	case INI_DUP_FIRST:
+	case INI_DUP_LAST:
+	case INI_DUP_COLLECT:
+	case INI_DUP_ERROR:
+		break;
+	default:
+		return NULL;
+	}
+	ini_dupes *dupes = calloc(1, sizeof(ini_dupes));
+	if (dupes == NULL)
+		return NULL;
+	dupes->policy = policy;
+	dupes->separator = separator ? separator : '\n';
+	return dupes;
+}
+
+void
+ini_dupes_free(
+	ini_dupes *dupes
+) {
+	if (dupes == NULL)
+		return;
+	for (size_t i = 0; i < dupes->sections.count; i++) {
+		dsec *s = (dsec *)dupes->sections.order[i];
+		for (size_t j = 0; j < s->keys.count; j++) {
+			dkey *k = (dkey *)s->keys.order[j];
+			free(k->n.name);
+			free(k->value);
+			free(k);
+		}
+		ini_table_free(&s->keys);
+		free(s->n.name);
+		free(s);
+	}
+	ini_table_free(&dupes->sections);
+	free(dupes);
+}
+
+/*
+ * find_section
+ *
+ * the record for a section, created if this is its first time.
+ * consecutive pairs nearly always share a section, so the last one
+ * found is checked first.
+ */
+
+static
+dsec *
+find_section(
+	ini_dupes *dupes,
+	const char *section
+) {
+	if (dupes->current != NULL && strcmp(dupes->current->n.name, section) == 0)
+		return dupes->current;
+
+	size_t len = strlen(section);
+	uint64_t hash = ini_hash_bytes(section, len, INI_HASH_SEED);
+	dsec *s = (dsec *)ini_table_find(&dupes->sections, section, hash);
+	if (s != NULL)
+		return dupes->current = s;
+
+	s = calloc(1, sizeof(dsec));
+	if (s == NULL)
+		return NULL;
+	s->n.name = copy_string(section, len);
+	s->n.hash = hash;
+	if (s->n.name == NULL || !ini_table_add(&dupes->sections, &s->n)) {
+		free(s->n.name);
+		free(s);
+		return NULL;
+	}
+	return dupes->current = s;
+}
+
+/*
+ * find_key
+ *
+ * the record for a key within a section. *added tells if it was
+ * created by this call.
+ */
+
+static
+dkey *
+find_key(
+	dsec *s,
+	const char *key,
+	bool *added
+) {
+	size_t len = strlen(key);
+	uint64_t hash = ini_hash_bytes(key, len, INI_HASH_SEED);
+	*added = false;
+	dkey *k = (dkey *)ini_table_find(&s->keys, key, hash);
+	if (k != NULL)
+		return k;
+
+	k = calloc(1, sizeof(dkey));
+	if (k == NULL)
+		return NULL;
+	k->n.name = copy_string(key, len);
+	k->n.hash = hash;
+	if (k->n.name == NULL || !ini_table_add(&s->keys, &k->n)) {
+		free(k->n.name);
+		free(k);
+		return NULL;
+	}
+	*added = true;
+	return k;
+}
+
+/*
+ * hold_value
+ *
+ * keep a value for delivery at flush. INI_DUP_LAST replaces what
+ * was held, INI_DUP_COLLECT appends to it after a separator.
+ */
+
+static
+bool
+hold_value(
+	ini_dupes *dupes,
+	dkey *k,
+	const char *value,
+	bool first
+) {
+	size_t vallen = strlen(value);
+	if (first || dupes->policy == INI_DUP_LAST) {
+		char *p = copy_string(value, vallen);
+		if (p == NULL)
+			return false;
+		free(k->value);
+		k->value = p;
+		k->len = vallen;
+		return true;
+	}
+
+	char *p = realloc(k->value, k->len + vallen + 2);
+	if (p == NULL)
+		return false;
+	p[k->len] = dupes->separator;
+	memcpy(p + k->len + 1, value, vallen + 1);
+	k->value = p;
+	k->len += vallen + 1;
+	return true;
+}
+
+int
+ini_dupes_pair(
+	ini_dupes *dupes,
+	const char *section,
+	const char *key,
+	const char *value,
+	fn_callback callback,
+	void *userdata
+) {
+	dsec *s = find_section(dupes, section);
+	if (s == NULL)
+		return INI_DUPES_ERROR;
+	bool added;
+	dkey *k = find_key(s, key, &added);
+	if (k == NULL)
+		return INI_DUPES_ERROR;
+
+	switch (dupes->policy) {
+	case INI_DUP_FIRST:
+		if (!added)
+			return INI_DUPES_OK;
+		break;
+	case INI_DUP_ERROR:
+		if (!added)
+			return INI_DUPES_ERROR;
+		break;
+	case INI_DUP_LAST:
+	case INI_DUP_COLLECT:
+		return hold_value(dupes, k, value, added)
+			? INI_DUPES_OK : INI_DUPES_ERROR;
+	default:
+		return INI_DUPES_ERROR;
+	}
+
+	return callback(section, key, value, userdata)
+		? INI_DUPES_STOP : INI_DUPES_OK;
+}
+
+int
+ini_dupes_flush(
+	ini_dupes *dupes,
+	fn_callback callback,
+	void *userdata
+) {
+	if (dupes->policy != INI_DUP_LAST && dupes->policy != INI_DUP_COLLECT)
+		return INI_DUPES_OK;
+
+	for (size_t i = 0; i < dupes->sections.count; i++) {
+		dsec *s = (dsec *)dupes->sections.order[i];
+		for (size_t j = 0; j < s->keys.count; j++) {
+			dkey *k = (dkey *)s->keys.order[j];
+			if (callback(s->n.name, k->n.name, k->value, userdata))
+				return INI_DUPES_STOP;
+		}
+	}
+	return INI_DUPES_OK;
+}
+
+/* inidupes.c ends here */
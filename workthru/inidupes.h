@@ -0,0 +1,89 @@
+/* inidupes.h -- duplicate section and key handling for the parser */
+
+#ifndef INIDUPES_H
+#define INIDUPES_H
+
+#include <stdbool.h>
+
+#include "iniparser.h"
+
+/*
+ * this is the parser's side of ini_options.duplicates, it is not
+ * meant to be called by clients. the parser hands each completed
+ * pair to ini_dupes_pair instead of the client callback, and calls
+ * ini_dupes_flush at end of file.
+ *
+ * INI_DUP_FIRST and INI_DUP_ERROR stream: a pair is passed on (or
+ * rejected) as soon as it is seen and only the names are kept.
+ *
+ * INI_DUP_LAST and INI_DUP_COLLECT can't know a value is final until
+ * the end of the file, so they hold the pairs and pass them on at
+ * flush. a section that appears more than once is delivered once,
+ * in the order of its first appearance, with its keys in the order
+ * of their first appearance.
+ */
+
+#define INI_DUPES_OK     0   /* carry on                        */
+#define INI_DUPES_STOP   1   /* the client asked for a stop     */
+#define INI_DUPES_ERROR  2   /* a duplicate under INI_DUP_ERROR */
+                             /* or memory is exhausted          */
+
+typedef struct ini_dupes ini_dupes;
+
+/*
+ * ini_dupes_create
+ *
+ * in    : an INI_DUP policy other than INI_DUP_ALL
+ * in    : separator for INI_DUP_COLLECT
+ * return: the tracker, or NULL if the policy is unknown or memory
+ *         is exhausted
+ */
+
+ini_dupes *
+ini_dupes_create(
+	int policy,
+	char separator
+);
+
+void
+ini_dupes_free(
+	ini_dupes *dupes
+);
+
+/*
+ * ini_dupes_pair
+ *
+ * apply the policy to one pair, calling the client if the pair is
+ * to be delivered now.
+ *
+ * return: an INI_DUPES code
+ */
+
+int
+ini_dupes_pair(
+	ini_dupes *dupes,
+	const char *section,
+	const char *key,
+	const char *value,
+	fn_callback callback,
+	void *userdata
+);
+
+/*
+ * ini_dupes_flush
+ *
+ * deliver any held pairs.
+ *
+ * return: an INI_DUPES code
+ */
+
+int
+ini_dupes_flush(
+	ini_dupes *dupes,
+	fn_callback callback,
+	void *userdata
+);
+
+#endif /* INIDUPES_H */
+
+/* inidupes.h ends here */
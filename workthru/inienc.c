@@ -0,0 +1,454 @@
+/* inienc.c -- byte order marks, UTF-16 input, and UTF-8 validation */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inienc.h"
+
+/*
+ * UTF-8 input is read straight into the parser's buffer and checked
+ * there, there is no copy. the first few bytes are read into 'in' to
+ * look for a byte order mark, and those are handed over first.
+ *
+ * UTF-16 input is read into 'in' and written out as UTF-8. a unit
+ * under 0x80 becomes one byte, and runs of those go through a tight
+ * loop. anything else is decoded, pairing surrogates, and encoded.
+ * if a character's bytes don't all fit in the caller's buffer the
+ * rest wait in 'pend' for the next read.
+ */
+
+#define DEC_BUFLEN 65536
+
+/*
+ * the validator's state between bytes, and between reads. 'need'
+ * continuation bytes are still to come, and the next one must be in
+ * lo..hi. the first continuation of some lead bytes has a narrower
+ * range, which rules out overlong forms, surrogates, and code points
+ * past U+10FFFF.
+ */
+
+typedef struct utf8_state {
+	int need;
+	unsigned char lo;
+	unsigned char hi;
+} utf8_state;
+
+struct ini_decoder {
+	fn_reader reader;
+	void *handle;
+	int mode;
+	int encoding;
+	bool started;
+	bool eof;
+	const char *error;
+	char message[96];
+
+	utf8_state state;
+	size_t skipped;      /* bytes of byte order mark           */
+	size_t delivered;    /* UTF-8 bytes handed to the caller   */
+
+	unsigned char pend[4];
+	int pend_pos;
+	int pend_len;
+
+	unsigned char in[DEC_BUFLEN];
+	size_t in_pos;
+	size_t in_len;
+	size_t in_base;      /* input offset of in[0]              */
+};
+
+#define ONES (~(uint64_t)0 / 255)
+#define HIGH (ONES * 0x80)
+
+/*
+ * utf8_check
+ *
+ * run the validator over a block.
+ *
+ * in/out: state carried from the block before
+ * in    : the block
+ * return: offset of the first bad byte, or len if there is none
+ */
+
+static
+size_t
+utf8_check(
+	utf8_state *st,
+	const unsigned char *p,
+	size_t len
+) {
+	size_t i = 0;
+	while (i < len) {
+		if (st->need == 0) {
+			while (len - i >= 16) {
+				uint64_t a;
+				uint64_t b;
+				memcpy(&a, p + i, 8);
+				memcpy(&b, p + i + 8, 8);
+				if (((a | b) & HIGH) != 0)
+					break;
+				i += 16;
+			}
+			if (i == len)
+				break;
+			unsigned char c = p[i];
+			if (c < 0x80) {
+				i += 1;
+				continue;
+			}
+			if (c < 0xc2)
+				return i;
+			if (c < 0xe0) {
+				st->need = 1;
+				st->lo = 0x80;
+				st->hi = 0xbf;
+			} else if (c < 0xf0) {
+				st->need = 2;
+				st->lo = c == 0xe0 ? 0xa0 : 0x80;
+				st->hi = c == 0xed ? 0x9f : 0xbf;
+			} else if (c < 0xf5) {
+				st->need = 3;
+				st->lo = c == 0xf0 ? 0x90 : 0x80;
+				st->hi = c == 0xf4 ? 0x8f : 0xbf;
+			} else
+				return i;
+			i += 1;
+			continue;
+		}
+		unsigned char c = p[i];
+		if (c < st->lo || c > st->hi)
+			return i;
+		st->need -= 1;
+		st->lo = 0x80;
+		st->hi = 0xbf;
+		i += 1;
+	}
+	return len;
+}
+
+bool
+ini_utf8_valid(
+	const char *bytes,
+	size_t len
+) {
+	utf8_state st = { 0, 0x80, 0xbf };
+	return utf8_check(&st, (const unsigned char *)bytes, len) == len
+		&& st.need == 0;
+}
+
+ini_decoder *
+ini_decoder_open(
+	fn_reader reader,
+	void *handle,
+	int mode
+) {
+	ini_decoder *d = calloc(1, sizeof(ini_decoder));
+	if (d == NULL)
+		return NULL;
+	d->reader = reader;
+	d->handle = handle;
+	d->mode = mode;
+	d->state.lo = 0x80;
+	d->state.hi = 0xbf;
+	return d;
+}
+
+void
+ini_decoder_close(
+	ini_decoder *d
+) {
+	free(d);
+}
+
+int
+ini_decoder_encoding(
+	const ini_decoder *d
+) {
+	return d->encoding;
+}
+
+const char *
+ini_decoder_error(
+	const ini_decoder *d
+) {
+	return d->error;
+}
+
+/*
+ * fail
+ *
+ * note why the read failed and where.
+ *
+ * return: -1, for the reader to return
+ */
+
+static
+long
+fail(
+	ini_decoder *d,
+	const char *why,
+	size_t offset
+) {
+	snprintf(d->message, sizeof(d->message), "%s at byte %zu", why, offset);
+	d->error = d->message;
+	return -1;
+}
+
+/*
+ * fill_input
+ *
+ * make sure 'in' holds at least 'least' unused bytes, unless the
+ * input ends first. unused bytes move to the front.
+ *
+ * return: true if there are 'least' bytes
+ */
+
+static
+bool
+fill_input(
+	ini_decoder *d,
+	size_t least
+) {
+	if (d->in_len - d->in_pos >= least)
+		return true;
+	memmove(d->in, d->in + d->in_pos, d->in_len - d->in_pos);
+	d->in_base += d->in_pos;
+	d->in_len -= d->in_pos;
+	d->in_pos = 0;
+	while (d->in_len < least && !d->eof) {
+		long got = d->reader(d->handle, (char *)d->in + d->in_len,
+				DEC_BUFLEN - d->in_len);
+		if (got < 0) {
+			fail(d, "read failed", d->in_base + d->in_len);
+			d->eof = true;
+		} else if (got == 0)
+			d->eof = true;
+		else
+			d->in_len += got;
+	}
+	return d->in_len >= least;
+}
+
+/*
+ * detect
+ *
+ * look at the first bytes for a byte order mark, or for the zero
+ * byte that an ASCII character has in UTF-16.
+ */
+
+static
+void
+detect(
+	ini_decoder *d
+) {
+	d->started = true;
+	fill_input(d, 4);
+	const unsigned char *p = d->in;
+	size_t n = d->in_len;
+	d->encoding = INI_ENC_UTF8;
+	if (n >= 3 && p[0] == 0xef && p[1] == 0xbb && p[2] == 0xbf) {
+		d->encoding = INI_ENC_UTF8_BOM;
+		d->skipped = 3;
+	} else if (n >= 2 && p[0] == 0xff && p[1] == 0xfe) {
+		d->encoding = INI_ENC_UTF16LE;
+		d->skipped = 2;
+	} else if (n >= 2 && p[0] == 0xfe && p[1] == 0xff) {
+		d->encoding = INI_ENC_UTF16BE;
+		d->skipped = 2;
+	} else if (n >= 2 && p[0] != 0 && p[0] < 0x80 && p[1] == 0)
+		d->encoding = INI_ENC_UTF16LE;
+	else if (n >= 2 && p[0] == 0 && p[1] != 0 && p[1] < 0x80)
+		d->encoding = INI_ENC_UTF16BE;
+	d->in_pos = d->skipped;
+}
+
+/*
+ * read_utf8
+ *
+ * hand over what's left in 'in' from detection, then read straight
+ * into the caller's buffer. check what was read if asked to.
+ */
+
+static
+long
+read_utf8(
+	ini_decoder *d,
+	char *buffer,
+	size_t buflen
+) {
+	size_t n = 0;
+	if (d->in_pos < d->in_len) {
+		n = d->in_len - d->in_pos < buflen ? d->in_len - d->in_pos : buflen;
+		memcpy(buffer, d->in + d->in_pos, n);
+		d->in_pos += n;
+	} else if (!d->eof) {
+		long got = d->reader(d->handle, buffer, buflen);
+		if (got < 0)
+			return fail(d, "read failed", d->skipped + d->delivered);
+		if (got == 0)
+			d->eof = true;
+		n = got;
+	}
+
+	if (d->mode == INI_ENC_VALIDATE) {
+		size_t bad = utf8_check(&d->state, (unsigned char *)buffer, n);
+		if (bad < n)
+			return fail(d, "invalid UTF-8",
+				d->skipped + d->delivered + bad);
+		if (n == 0 && d->state.need != 0)
+			return fail(d, "truncated UTF-8",
+				d->skipped + d->delivered);
+	}
+	d->delivered += n;
+	return n;
+}
+
+/*
+ * put_code
+ *
+ * encode a code point as UTF-8 into the caller's buffer, keeping
+ * what doesn't fit for the next read.
+ *
+ * return: bytes written to buffer
+ */
+
+static
+size_t
+put_code(
+	ini_decoder *d,
+	unsigned cp,
+	char *buffer,
+	size_t room
+) {
+	unsigned char u[4];
+	int n;
+	if (cp < 0x80) {
+		u[0] = cp;
+		n = 1;
+	} else if (cp < 0x800) {
+		u[0] = 0xc0 | cp >> 6;
+		u[1] = 0x80 | (cp & 0x3f);
+		n = 2;
+	} else if (cp < 0x10000) {
+		u[0] = 0xe0 | cp >> 12;
+		u[1] = 0x80 | (cp >> 6 & 0x3f);
+		u[2] = 0x80 | (cp & 0x3f);
+		n = 3;
+	} else {
+		u[0] = 0xf0 | cp >> 18;
+		u[1] = 0x80 | (cp >> 12 & 0x3f);
+		u[2] = 0x80 | (cp >> 6 & 0x3f);
+		u[3] = 0x80 | (cp & 0x3f);
+		n = 4;
+	}
+	size_t put = (size_t)n < room ? (size_t)n : room;
+	memcpy(buffer, u, put);
+	memcpy(d->pend, u + put, n - put);
+	d->pend_pos = 0;
+	d->pend_len = n - put;
+	return put;
+}
+
+/*
+ * read_utf16
+ *
+ * transcode until the caller's buffer is full or the input ends.
+ */
+
+static
+long
+read_utf16(
+	ini_decoder *d,
+	char *buffer,
+	size_t buflen
+) {
+	bool be = d->encoding == INI_ENC_UTF16BE;
+	int hi = be ? 0 : 1;    /* which byte of a unit is high */
+	int lo = 1 - hi;
+	size_t out = 0;
+
+	while (d->pend_pos < d->pend_len && out < buflen)
+		buffer[out++] = d->pend[d->pend_pos++];
+
+	while (out < buflen) {
+		if (!fill_input(d, 2)) {
+			if (d->error != NULL)
+				return -1;
+			if (d->in_pos == d->in_len)
+				break;
+			/* a last odd byte. */
+			d->in_pos = d->in_len;
+			if (d->mode == INI_ENC_VALIDATE)
+				return fail(d, "odd byte at end of UTF-16",
+					d->in_base + d->in_len - 1);
+			out += put_code(d, 0xfffd, buffer + out, buflen - out);
+			continue;
+		}
+
+		/* the ASCII run. */
+
+		const unsigned char *p = d->in + d->in_pos;
+		size_t units = (d->in_len - d->in_pos) / 2;
+		size_t room = buflen - out;
+		size_t limit = units < room ? units : room;
+		size_t k = 0;
+		while (k < limit && p[2*k + hi] == 0 && p[2*k + lo] < 0x80) {
+			buffer[out + k] = p[2*k + lo];
+			k += 1;
+		}
+		out += k;
+		d->in_pos += 2 * k;
+		if (k == limit)
+			continue;
+
+		/* one character outside ASCII. */
+
+		size_t at = d->in_base + d->in_pos;
+		unsigned u = p[2*k + hi] << 8 | p[2*k + lo];
+		unsigned cp = u;
+		d->in_pos += 2;
+		if (u >= 0xdc00 && u <= 0xdfff)
+			cp = 0xfffd;
+		else if (u >= 0xd800 && u <= 0xdbff) {
+			cp = 0xfffd;
+			if (fill_input(d, 2)) {
+				const unsigned char *q = d->in + d->in_pos;
+				unsigned v = q[hi] << 8 | q[lo];
+				if (v >= 0xdc00 && v <= 0xdfff) {
+					cp = 0x10000 + ((u - 0xd800) << 10) + (v - 0xdc00);
+					d->in_pos += 2;
+				}
+			} else if (d->error != NULL)
+				return -1;
+		}
+		if (cp == 0xfffd && u != 0xfffd && d->mode == INI_ENC_VALIDATE)
+			return fail(d, "unpaired UTF-16 surrogate", at);
+		out += put_code(d, cp, buffer + out, buflen - out);
+	}
+	d->delivered += out;
+	return out;
+}
+
+long
+ini_decoder_read(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	ini_decoder *d = handle;
+	if (d->error != NULL)
+		return -1;
+	if (!d->started) {
+		detect(d);
+		if (d->error != NULL)
+			return -1;
+	}
+	if (d->encoding == INI_ENC_UTF16LE || d->encoding == INI_ENC_UTF16BE)
+		return read_utf16(d, buffer, buflen);
+	return read_utf8(d, buffer, buflen);
+}
+
+/* inienc.c ends here */
@@ -0,0 +1,111 @@
+/* inienc.h -- byte order marks, UTF-16 input, and UTF-8 validation */
+
+#ifndef INIENC_H
+#define INIENC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "iniparser.h"
+
+/*
+ * a reader that sits between another reader and the parser so that
+ * the parser always sees UTF-8.
+ *
+ * - a UTF-8 byte order mark is dropped.
+ * - UTF-16LE and UTF-16BE, found by their byte order mark or, for
+ *   files without one, by a zero byte beside an ASCII first byte,
+ *   are transcoded to UTF-8 block by block as they are read.
+ * - with INI_ENC_VALIDATE, the UTF-8 the parser will see is checked
+ *   and a bad sequence fails the read, which fails the parse. the
+ *   whole stream is checked, comments included, since that costs
+ *   less than picking out names and values. without it, bytes pass
+ *   as they are, and bad UTF-16 becomes U+FFFD.
+ *
+ * parse_ini_ex and parse_ini_reader put one in front of their input
+ * when ini_options.encoding is set. used directly, it says why a
+ * read failed:
+ *
+ *   ini_decoder *d = ini_decoder_open(reader, handle, INI_ENC_VALIDATE);
+ *   parse_ini_reader(ini_decoder_read, d, ctx, callback, NULL);
+ *   if (ini_decoder_error(d)) ...
+ *   ini_decoder_close(d);
+ *
+ * the validator looks at eight bytes at a time and skips words that
+ * are all ASCII, which ini files nearly always are, and walks the
+ * rest a byte at a time.
+ */
+
+#define INI_ENC_RAW      0  /* the parser's default, no decoder */
+#define INI_ENC_DETECT   1  /* drop a BOM, transcode UTF-16     */
+#define INI_ENC_VALIDATE 3  /* detect, and reject bad UTF-8     */
+
+/* what was found. */
+
+#define INI_ENC_UTF8     0
+#define INI_ENC_UTF8_BOM 1
+#define INI_ENC_UTF16LE  2
+#define INI_ENC_UTF16BE  3
+
+typedef struct ini_decoder ini_decoder;
+
+/*
+ * ini_decoder_open
+ *
+ * in    : reader and handle for the raw input
+ * in    : INI_ENC_DETECT or INI_ENC_VALIDATE
+ * return: the decoder or NULL if memory is exhausted
+ */
+
+ini_decoder *
+ini_decoder_open(
+	fn_reader reader,
+	void *handle,
+	int mode
+);
+
+/* the fn_reader to hand to parse_ini_reader. */
+
+long
+ini_decoder_read(
+	void *handle,
+	char *buffer,
+	size_t buflen
+);
+
+/* INI_ENC_UTF8 etc., known after the first read. */
+
+int
+ini_decoder_encoding(
+	const ini_decoder *d
+);
+
+/* why the last read failed, with the input byte offset, or NULL. */
+
+const char *
+ini_decoder_error(
+	const ini_decoder *d
+);
+
+void
+ini_decoder_close(
+	ini_decoder *d
+);
+
+/*
+ * ini_utf8_valid
+ *
+ * check a whole string with the same validator.
+ *
+ * return: true if every byte of it is well formed UTF-8
+ */
+
+bool
+ini_utf8_valid(
+	const char *bytes,
+	size_t len
+);
+
+#endif /* INIENC_H */
+
+/* inienc.h ends here */
@@ -0,0 +1,145 @@
+/* inifold.c -- case folding for section and key names */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "inifold.h"
+
+/*
+ * fold_ascii_word
+ *
+ * fold the A-Z bytes of eight bytes at once. each byte's low seven
+ * bits are offset so that the top bit comes out set for bytes from
+ * 'A' up and for bytes past 'Z'. the two differ only for A-Z. bytes
+ * with the top bit set are left alone. the result's top bits, moved
+ * down to 0x20, flip those bytes to lower case.
+ */
+
+#define ONES (~(uint64_t)0 / 255)
+#define HIGH (ONES * 0x80)
+
+static
+uint64_t
+fold_ascii_word(
+	uint64_t w
+) {
+	uint64_t low = w & ~HIGH;
+	uint64_t from_a = low + ONES * (0x80 - 'A');
+	uint64_t past_z = low + ONES * (0x80 - 'Z' - 1);
+	uint64_t upper = (from_a ^ past_z) & ~w & HIGH;
+	return w ^ (upper >> 2);
+}
+
+/*
+ * fold_code
+ *
+ * unicode simple case folding for two byte UTF-8 code points, the
+ * ranges that fold to another two byte code point.
+ */
+
+static
+unsigned
+fold_code(
+	unsigned c
+) {
+	if (c == 0xb5)
+		return 0x3bc;                   /* micro sign */
+	if (c >= 0xc0 && c <= 0xde && c != 0xd7)
+		return c + 0x20;                /* latin-1 */
+	if (c >= 0x100 && c <= 0x17f) {         /* latin extended-a */
+		if ((c <= 0x12f || (c >= 0x132 && c <= 0x137)
+			|| (c >= 0x14a && c <= 0x177)) && c % 2 == 0)
+			return c + 1;
+		if (((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e))
+			&& c % 2 == 1)
+			return c + 1;
+		if (c == 0x178)
+			return 0xff;
+		return c;
+	}
+	if (c >= 0x386 && c <= 0x3ab) {         /* greek */
+		if (c == 0x386)
+			return 0x3ac;
+		if (c >= 0x388 && c <= 0x38a)
+			return c + 0x25;
+		if (c == 0x38c)
+			return 0x3cc;
+		if (c == 0x38e || c == 0x38f)
+			return c + 0x3f;
+		if (c >= 0x391 && c != 0x3a2)
+			return c + 0x20;
+		return c;
+	}
+	if (c == 0x3c2)
+		return 0x3c3;                   /* final sigma */
+	if (c >= 0x400 && c <= 0x40f)
+		return c + 0x50;                /* cyrillic */
+	if (c >= 0x410 && c <= 0x42f)
+		return c + 0x20;
+	return c;
+}
+
+/*
+ * fold_tail
+ *
+ * fold a run byte by byte from p, for what is left after the word
+ * loop and for text that isn't all ASCII.
+ */
+
+static
+void
+fold_tail(
+	unsigned char *p,
+	unsigned char *end,
+	bool unicode
+) {
+	while (p < end) {
+		if (*p >= 'A' && *p <= 'Z') {
+			*p += 0x20;
+			p += 1;
+			continue;
+		}
+		if (!unicode || *p < 0xc2 || *p > 0xdf || p + 1 == end
+			|| (p[1] & 0xc0) != 0x80) {
+			p += 1;
+			continue;
+		}
+		unsigned c = (p[0] & 0x1f) << 6 | (p[1] & 0x3f);
+		unsigned f = fold_code(c);
+		p[0] = 0xc0 | f >> 6;
+		p[1] = 0x80 | (f & 0x3f);
+		p += 2;
+	}
+}
+
+size_t
+ini_fold(
+	char *name,
+	int mode
+) {
+	size_t len = strlen(name);
+	if (mode == INI_FOLD_NONE)
+		return len;
+
+	unsigned char *p = (unsigned char *)name;
+	unsigned char *end = p + len;
+
+	/* eight bytes at a time while they are all ASCII. a word with
+	 * a high bit set in unicode mode goes to the slow path, which
+	 * runs to the end of the name. */
+
+	while (end - p >= 8) {
+		uint64_t w;
+		memcpy(&w, p, 8);
+		if ((w & HIGH) != 0 && mode == INI_FOLD_UNICODE)
+			break;
+		w = fold_ascii_word(w);
+		memcpy(p, &w, 8);
+		p += 8;
+	}
+	fold_tail(p, end, mode == INI_FOLD_UNICODE);
+	return len;
+}
+
+/* inifold.c ends here */
@@ -0,0 +1,47 @@
+/* inifold.h -- case folding for section and key names */
+
+#ifndef INIFOLD_H
+#define INIFOLD_H
+
+#include <stddef.h>
+
+/*
+ * names from windows tooling come in any case, [Network] and
+ * [network] are the same section. folding maps each name to one
+ * spelling so they compare and hash alike.
+ *
+ *   INI_FOLD_NONE    - names are compared as they are
+ *   INI_FOLD_ASCII   - A-Z fold to a-z, all other bytes are kept
+ *   INI_FOLD_UNICODE - ASCII, plus unicode simple case folding of
+ *                      UTF-8 letters in Latin-1, Latin Extended-A,
+ *                      the Greek alphabet, and basic Cyrillic
+ *
+ * only foldings that keep the UTF-8 length are done, so a name
+ * folds in place and never grows. that leaves out the few that
+ * change length, such as the long s and the Kelvin sign. invalid
+ * UTF-8 is kept as it is.
+ */
+
+#define INI_FOLD_NONE    0
+#define INI_FOLD_ASCII   1
+#define INI_FOLD_UNICODE 2
+
+/*
+ * ini_fold
+ *
+ * fold a name in place.
+ *
+ * in/out: the name
+ * in    : INI_FOLD mode
+ * return: the length of the name
+ */
+
+size_t
+ini_fold(
+	char *name,
+	int mode
+);
+
+#endif /* INIFOLD_H */
+
+/* inifold.h ends here */
@@ -0,0 +1,244 @@
+/* inihash.c -- small hashing helpers shared by the ini modules */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+
+/*
+ * fnv-1a is not the fastest hash around, but it is tiny, has no
+ * alignment concerns, and section and key names are short.
+ */
+
+uint64_t
+ini_hash_bytes(
+	const void *bytes,
+	size_t len,
+	uint64_t seed
+) {
+	const unsigned char *p = bytes;
+	uint64_t h = seed;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/*
+ * xxh64, from the published description. the input is read with
+ * shifts rather than loads so that alignment and byte order don't
+ * matter; compilers turn read64 into a single load where they can.
+ */
+
+#define P1 0x9e3779b185ebca87ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+#define P3 0x165667b19e3779f9ULL
+#define P4 0x85ebca77c2b2ae63ULL
+#define P5 0x27d4eb2f165667c5ULL
+
+static
+uint64_t
+rotl(
+	uint64_t x,
+	int r
+) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static
+uint64_t
+read64(
+	const unsigned char *p
+) {
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16
+		| (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32
+		| (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48
+		| (uint64_t)p[7] << 56;
+}
+
+static
+uint64_t
+read32(
+	const unsigned char *p
+) {
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16
+		| (uint64_t)p[3] << 24;
+}
+
+static
+uint64_t
+round64(
+	uint64_t acc,
+	uint64_t input
+) {
+	acc += input * P2;
+	acc = rotl(acc, 31);
+	return acc * P1;
+}
+
+static
+uint64_t
+merge64(
+	uint64_t acc,
+	uint64_t v
+) {
+	acc ^= round64(0, v);
+	return acc * P1 + P4;
+}
+
+uint64_t
+ini_hash_fast(
+	const void *bytes,
+	size_t len,
+	uint64_t seed
+) {
+	const unsigned char *p = bytes;
+	const unsigned char *end = p + len;
+	uint64_t h;
+
+	if (len >= 32) {
+		uint64_t v1 = seed + P1 + P2;
+		uint64_t v2 = seed + P2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - P1;
+		do {
+			v1 = round64(v1, read64(p));
+			v2 = round64(v2, read64(p + 8));
+			v3 = round64(v3, read64(p + 16));
+			v4 = round64(v4, read64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge64(h, v1);
+		h = merge64(h, v2);
+		h = merge64(h, v3);
+		h = merge64(h, v4);
+	} else
+		h = seed + P5;
+
+	h += len;
+	while (end - p >= 8) {
+		h ^= round64(0, read64(p));
+		h = rotl(h, 27) * P1 + P4;
+		p += 8;
+	}
+	if (end - p >= 4) {
+		h ^= read32(p) * P1;
+		h = rotl(h, 23) * P2 + P3;
+		p += 4;
+	}
+	while (p < end) {
+		h ^= *p * P5;
+		h = rotl(h, 11) * P1;
+		p += 1;
+	}
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t
+ini_hash_pair(
+	const char *section,
+	const char *key
+) {
+	/* the terminating \0 of section is hashed as a separator so
+	 * that "ab"+"c" and "a"+"bc" differ. */
+
+	uint64_t h = ini_hash_bytes(section, strlen(section) + 1, INI_HASH_SEED);
+	return ini_hash_bytes(key, strlen(key), h);
+}
+
+/*
+ * slot_for
+ *
+ * the slot holding 'name', or the empty slot where it belongs.
+ */
+
+static
+size_t
+slot_for(
+	ini_named **slots,
+	size_t capacity,
+	const char *name,
+	uint64_t hash
+) {
+	size_t mask = capacity - 1;
+	size_t slot = hash & mask;
+	while (slots[slot] != NULL) {
+		ini_named *n = slots[slot];
+		if (n->hash == hash && strcmp(n->name, name) == 0)
+			break;
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+ini_named *
+ini_table_find(
+	const ini_table *table,
+	const char *name,
+	uint64_t hash
+) {
+	if (table->capacity == 0)
+		return NULL;
+	return table->slots[slot_for(table->slots, table->capacity, name, hash)];
+}
+
+/*
+ * ini_table_add
+ *
+ * when one more item would leave the table more than half full,
+ * double it and rehash from the order array. the order array holds
+ * at most half the table size.
+ */
+
+bool
+ini_table_add(
+	ini_table *table,
+	ini_named *item
+) {
+	if ((table->count + 1) * 2 > table->capacity) {
+		size_t bigger = table->capacity ? table->capacity * 2 : 16;
+		ini_named **order = realloc(table->order, bigger / 2 * sizeof(ini_named *));
+		if (order == NULL)
+			return false;
+		table->order = order;
+		ini_named **slots = calloc(bigger, sizeof(ini_named *));
+		if (slots == NULL)
+			return false;
+		for (size_t i = 0; i < table->count; i++) {
+			ini_named *n = order[i];
+			slots[slot_for(slots, bigger, n->name, n->hash)] = n;
+		}
+		free(table->slots);
+		table->slots = slots;
+		table->capacity = bigger;
+	}
+	table->slots[slot_for(table->slots, table->capacity,
+				item->name, item->hash)] = item;
+	table->order[table->count] = item;
+	table->count += 1;
+	return true;
+}
+
+void
+ini_table_free(
+	ini_table *table
+) {
+	free(table->slots);
+	free(table->order);
+	table->slots = NULL;
+	table->order = NULL;
+	table->capacity = 0;
+	table->count = 0;
+}
+
+/* inihash.c ends here */
@@ -0,0 +1,124 @@
+/* inihash.h -- small hashing helpers shared by the ini modules */
+
+#ifndef INIHASH_H
+#define INIHASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * ini_hash_bytes
+ *
+ * 64 bit fnv-1a over a run of bytes. chain calls by passing the
+ * previous result as 'seed', start with INI_HASH_SEED.
+ *
+ * in    : bytes to hash
+ * in    : length of bytes
+ * in    : seed or previous hash
+ * return: the hash
+ */
+
+#define INI_HASH_SEED 0xcbf29ce484222325ULL
+
+uint64_t
+ini_hash_bytes(
+	const void *bytes,
+	size_t len,
+	uint64_t seed
+);
+
+/*
+ * ini_hash_fast
+ *
+ * 64 bit xxh64 over a run of bytes, eight bytes at a time. much
+ * faster than ini_hash_bytes on anything longer than a name. bytes
+ * are read little endian, so the result is the same on every
+ * machine. chain calls by passing the previous result as 'seed'.
+ *
+ * in    : bytes to hash
+ * in    : length of bytes
+ * in    : seed or previous hash
+ * return: the hash
+ */
+
+uint64_t
+ini_hash_fast(
+	const void *bytes,
+	size_t len,
+	uint64_t seed
+);
+
+/*
+ * ini_hash_pair
+ *
+ * hash a section and key as the byte string "section\0key".
+ */
+
+uint64_t
+ini_hash_pair(
+	const char *section,
+	const char *key
+);
+
+/*
+ * ini_table
+ *
+ * an open addressed hash table of names, kept at most half full,
+ * with an array of the same items in the order they were added.
+ * items are structures whose first member is an ini_named. the
+ * table does not own the items or their names.
+ *
+ *   typedef struct thing {
+ *           ini_named n;
+ *           ...
+ *   } thing;
+ *
+ *   thing *t = (thing *)ini_table_find(&table, name, hash);
+ *
+ * a zeroed ini_table is empty and ready for use.
+ */
+
+typedef struct ini_named {
+	char *name;
+	uint64_t hash;
+} ini_named;
+
+typedef struct ini_table {
+	ini_named **slots;
+	size_t capacity;
+	ini_named **order;
+	size_t count;
+} ini_table;
+
+/* the item with this name, or NULL. */
+
+ini_named *
+ini_table_find(
+	const ini_table *table,
+	const char *name,
+	uint64_t hash
+);
+
+/*
+ * add an item not already in the table.
+ *
+ * return: false if memory is exhausted
+ */
+
+bool
+ini_table_add(
+	ini_table *table,
+	ini_named *item
+);
+
+/* release the table's arrays, not the items. */
+
+void
+ini_table_free(
+	ini_table *table
+);
+
+#endif /* INIHASH_H */
+
+/* inihash.h ends here */
@@ -0,0 +1,749 @@
+/* iniindex.c -- an ordered index over the pairs of a parsed ini file */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inifold.h"
+#include "inihash.h"
+#include "iniindex.h"
+
+/*
+ * clients kept asking the same questions of their parsed files: all
+ * the keys in [routes] that start with 'backend.', all the sections
+ * that look like 'tenant.*'. the callback interface can only answer
+ * those with a full reparse or a scan of some client side map.
+ *
+ * the index is built once after the parse. entries are appended in
+ * file order as the parser reports them, then sorted. each entry
+ * holds its three strings in a single allocation laid out as
+ * "section\0key\0value\0".
+ *
+ * a sorted array was chosen over a trie. it is two allocations (plus
+ * the strings), it is easy to walk in order, and a binary search is
+ * as fast as anything else for the sizes of files we see.
+ *
+ * when folding, the folded section and key follow in the same block,
+ * "section\0key\0value\0folded section\0folded key\0". ini_index_get
+ * goes through 'lookup', an open addressed table of the last entry
+ * of each section:key, built by finish from the stored hashes.
+ */
+
+struct ini_index {
+	ini_entry *entries;
+	size_t count;
+	size_t capacity;
+	ini_section *sections;
+	size_t section_count;
+	const ini_entry **lookup;
+	size_t lookup_size;  /* a power of two, at most half full */
+	int fold;
+	bool failed;         /* an add failed, finish will report it */
+	bool finished;
+};
+
+/*
+ * ini_index_create
+ *
+ * create an empty unfinished index.
+ */
+
+ini_index *
+ini_index_create(void) {
+	return calloc(1, sizeof(ini_index));
+}
+
+ini_index *
+ini_index_create_ex(
+	int fold
+) {
+	ini_index *idx = calloc(1, sizeof(ini_index));
+	if (idx != NULL)
+		idx->fold = fold;
+	return idx;
+}
+
+/*
+ * ini_index_add
+ *
+ * copy the strings into one block and append an entry. the entry
+ * array doubles as needed. this is where names are folded, once.
+ */
+
+bool
+ini_index_add(
+	ini_index *idx,
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	if (idx->failed || idx->finished)
+		return false;
+
+	if (idx->count == idx->capacity) {
+		size_t capacity = idx->capacity ? idx->capacity * 2 : 64;
+		ini_entry *p = realloc(idx->entries, capacity * sizeof(ini_entry));
+		if (p == NULL) {
+			idx->failed = true;
+			return false;
+		}
+		idx->entries = p;
+		idx->capacity = capacity;
+	}
+
+	size_t seclen = strlen(section) + 1;
+	size_t keylen = strlen(key) + 1;
+	size_t vallen = strlen(value) + 1;
+	size_t folded = idx->fold != INI_FOLD_NONE ? seclen + keylen : 0;
+	char *block = malloc(seclen + keylen + vallen + folded);
+	if (block == NULL) {
+		idx->failed = true;
+		return false;
+	}
+	memcpy(block, section, seclen);
+	memcpy(block + seclen, key, keylen);
+	memcpy(block + seclen + keylen, value, vallen);
+
+	ini_entry *e = &idx->entries[idx->count];
+	e->section = block;
+	e->key = block + seclen;
+	e->value = block + seclen + keylen;
+	e->seq = idx->count;
+	e->section_fold = e->section;
+	e->key_fold = e->key;
+	if (folded != 0) {
+		char *p = block + seclen + keylen + vallen;
+		memcpy(p, section, seclen);
+		memcpy(p + seclen, key, keylen);
+		ini_fold(p, idx->fold);
+		ini_fold(p + seclen, idx->fold);
+		e->section_fold = p;
+		e->key_fold = p + seclen;
+	}
+	e->hash = ini_hash_pair(e->section_fold, e->key_fold);
+	idx->count += 1;
+	return true;
+}
+
+/*
+ * ini_index_callback
+ *
+ * feed parse_ini straight into an index.
+ */
+
+bool
+ini_index_callback(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+) {
+	return !ini_index_add(user_data, section, key, value);
+}
+
+/*
+ * compare_entries
+ *
+ * qsort ordering: section, key, then file order. the file order
+ * tie breaker makes the sort stable.
+ */
+
+static
+int
+compare_entries(
+	const void *a,
+	const void *b
+) {
+	const ini_entry *x = a;
+	const ini_entry *y = b;
+	int c = strcmp(x->section_fold, y->section_fold);
+	if (c != 0)
+		return c;
+	c = strcmp(x->key_fold, y->key_fold);
+	if (c != 0)
+		return c;
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/*
+ * same_pair
+ *
+ * do two entries have the same folded section and key.
+ */
+
+static
+bool
+same_pair(
+	const ini_entry *x,
+	const char *section_fold,
+	const char *key_fold,
+	uint64_t hash
+) {
+	return x->hash == hash && strcmp(x->key_fold, key_fold) == 0
+		&& strcmp(x->section_fold, section_fold) == 0;
+}
+
+/*
+ * build_lookup
+ *
+ * hash every section:key into 'lookup'. entries are taken in index
+ * order, so of a repeated key the last one in the file wins.
+ */
+
+static
+bool
+build_lookup(
+	ini_index *idx
+) {
+	size_t size = 16;
+	while (size < idx->count * 2)
+		size *= 2;
+	idx->lookup = calloc(size, sizeof(ini_entry *));
+	if (idx->lookup == NULL)
+		return false;
+	idx->lookup_size = size;
+
+	for (size_t i = 0; i < idx->count; i++) {
+		const ini_entry *e = &idx->entries[i];
+		size_t slot = e->hash & (size - 1);
+		while (idx->lookup[slot] != NULL && !same_pair(idx->lookup[slot],
+				e->section_fold, e->key_fold, e->hash))
+			slot = (slot + 1) & (size - 1);
+		idx->lookup[slot] = e;
+	}
+	return true;
+}
+
+/*
+ * ini_index_finish
+ *
+ * sort the entries and build the section table from the runs of
+ * equal section names, then the lookup table.
+ */
+
+bool
+ini_index_finish(
+	ini_index *idx
+) {
+	if (idx->failed)
+		return false;
+	if (idx->finished)
+		return true;
+
+	if (idx->count > 1)
+		qsort(idx->entries, idx->count, sizeof(ini_entry), compare_entries);
+
+	size_t distinct = 0;
+	for (size_t i = 0; i < idx->count; i++)
+		if (i == 0 || strcmp(idx->entries[i].section_fold,
+				idx->entries[i-1].section_fold) != 0)
+			distinct += 1;
+
+	if (distinct > 0) {
+		idx->sections = malloc(distinct * sizeof(ini_section));
+		if (idx->sections == NULL) {
+			idx->failed = true;
+			return false;
+		}
+	}
+
+	ini_section *s = NULL;
+	for (size_t i = 0; i < idx->count; i++) {
+		ini_entry *e = &idx->entries[i];
+		if (s == NULL || strcmp(e->section_fold, s->name_fold) != 0) {
+			s = &idx->sections[idx->section_count];
+			idx->section_count += 1;
+			s->name = e->section;
+			s->name_fold = e->section_fold;
+			s->first = e;
+			s->count = 0;
+		}
+		s->count += 1;
+	}
+
+	if (!build_lookup(idx)) {
+		idx->failed = true;
+		return false;
+	}
+	idx->finished = true;
+	return true;
+}
+
+/*
+ * ini_index_build
+ *
+ * parse a stream into a new index.
+ */
+
+ini_index *
+ini_index_build(
+	FILE *ini_file
+) {
+	return ini_index_build_ex(ini_file, INI_FOLD_NONE);
+}
+
+ini_index *
+ini_index_build_ex(
+	FILE *ini_file,
+	int fold
+) {
+	ini_index *idx = ini_index_create_ex(fold);
+	if (idx == NULL)
+		return NULL;
+	int status = parse_ini(ini_file, idx, ini_index_callback);
+	if (status != EXIT_SUCCESS || !ini_index_finish(idx)) {
+		ini_index_free(idx);
+		return NULL;
+	}
+	return idx;
+}
+
+void
+ini_index_free(
+	ini_index *idx
+) {
+	if (idx == NULL)
+		return;
+	for (size_t i = 0; i < idx->count; i++)
+		free((char *)idx->entries[i].section);
+	free(idx->entries);
+	free(idx->sections);
+	free(idx->lookup);
+	free(idx);
+}
+
+ini_range
+ini_index_entries(
+	const ini_index *idx
+) {
+	ini_range r = { idx->entries, idx->count };
+	return r;
+}
+
+ini_section_range
+ini_index_sections(
+	const ini_index *idx
+) {
+	ini_section_range r = { idx->sections, idx->section_count };
+	return r;
+}
+
+/*
+ * folding query arguments. a name short enough is folded in the
+ * buffer, a longer one in a heap copy, and without folding the
+ * name is used as it is. NULL stays NULL, for open range bounds.
+ */
+
+typedef struct folded {
+	const char *name;
+	char *heap;
+	char buf[INI_SEC_MAXLEN + 1];
+} folded;
+
+static
+bool
+fold_query(
+	const ini_index *idx,
+	const char *name,
+	folded *f
+) {
+	f->name = name;
+	f->heap = NULL;
+	if (name == NULL || idx->fold == INI_FOLD_NONE)
+		return true;
+	size_t len = strlen(name);
+	char *p = f->buf;
+	if (len >= sizeof(f->buf)) {
+		p = f->heap = malloc(len + 1);
+		if (p == NULL)
+			return false;
+	}
+	memcpy(p, name, len + 1);
+	ini_fold(p, idx->fold);
+	f->name = p;
+	return true;
+}
+
+static
+void
+fold_done(
+	folded *f
+) {
+	free(f->heap);
+}
+
+/*
+ * the searches. each is a lower bound over a sorted run: find the
+ * first element for which name_ahead is false. everything before it
+ * sorts ahead of the target.
+ *
+ * name_ahead is name < target, or when 'prefix' is set, name sorts
+ * before or starts with target. the second form finds the end of a
+ * prefix run.
+ *
+ * from here down, names compared are folded names, and the static
+ * functions take query arguments already folded.
+ */
+
+static
+bool
+name_ahead(
+	const char *name,
+	const char *target,
+	size_t prefix_len,
+	bool prefix
+) {
+	if (prefix)
+		return strncmp(name, target, prefix_len) <= 0;
+	return strcmp(name, target) < 0;
+}
+
+static
+size_t
+entry_bound(
+	const ini_entry *run,
+	size_t count,
+	const char *target,
+	bool prefix
+) {
+	size_t prefix_len = prefix ? strlen(target) : 0;
+	size_t lo = 0;
+	size_t hi = count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (name_ahead(run[mid].key_fold, target, prefix_len, prefix))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static
+size_t
+section_bound(
+	const ini_section *run,
+	size_t count,
+	const char *target,
+	bool prefix
+) {
+	size_t prefix_len = prefix ? strlen(target) : 0;
+	size_t lo = 0;
+	size_t hi = count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (name_ahead(run[mid].name_fold, target, prefix_len, prefix))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static
+const ini_section *
+find_section(
+	const ini_index *idx,
+	const char *section
+) {
+	size_t i = section_bound(idx->sections, idx->section_count,
+			section, false);
+	if (i < idx->section_count
+		&& strcmp(idx->sections[i].name_fold, section) == 0)
+		return &idx->sections[i];
+	return NULL;
+}
+
+const ini_section *
+ini_index_section(
+	const ini_index *idx,
+	const char *section
+) {
+	folded sec;
+	if (!fold_query(idx, section, &sec))
+		return NULL;
+	const ini_section *s = find_section(idx, sec.name);
+	fold_done(&sec);
+	return s;
+}
+
+const ini_entry *
+ini_index_get(
+	const ini_index *idx,
+	const char *section,
+	const char *key
+) {
+	if (idx->lookup == NULL)
+		return NULL;
+	folded sec;
+	folded k;
+	if (!fold_query(idx, section, &sec))
+		return NULL;
+	if (!fold_query(idx, key, &k)) {
+		fold_done(&sec);
+		return NULL;
+	}
+
+	uint64_t hash = ini_hash_pair(sec.name, k.name);
+	size_t mask = idx->lookup_size - 1;
+	size_t slot = hash & mask;
+	const ini_entry *e;
+	while ((e = idx->lookup[slot]) != NULL
+		&& !same_pair(e, sec.name, k.name, hash))
+		slot = (slot + 1) & mask;
+
+	fold_done(&sec);
+	fold_done(&k);
+	return e;
+}
+
+static
+ini_range
+key_prefix(
+	const ini_section *s,
+	const char *prefix
+) {
+	ini_range r = { NULL, 0 };
+	if (s == NULL)
+		return r;
+	size_t lo = entry_bound(s->first, s->count, prefix, false);
+	size_t hi = entry_bound(s->first, s->count, prefix, true);
+	r.first = s->first + lo;
+	r.count = hi > lo ? hi - lo : 0;
+	return r;
+}
+
+ini_range
+ini_index_key_prefix(
+	const ini_index *idx,
+	const char *section,
+	const char *prefix
+) {
+	ini_range r = { NULL, 0 };
+	folded sec;
+	folded pre;
+	if (!fold_query(idx, section, &sec))
+		return r;
+	if (fold_query(idx, prefix, &pre)) {
+		r = key_prefix(find_section(idx, sec.name), pre.name);
+		fold_done(&pre);
+	}
+	fold_done(&sec);
+	return r;
+}
+
+ini_range
+ini_index_key_range(
+	const ini_index *idx,
+	const char *section,
+	const char *lo,
+	const char *hi
+) {
+	ini_range r = { NULL, 0 };
+	folded sec;
+	folded from_name;
+	folded to_name;
+	if (!fold_query(idx, section, &sec))
+		return r;
+	bool ok = fold_query(idx, lo, &from_name);
+	if (ok && !fold_query(idx, hi, &to_name)) {
+		fold_done(&from_name);
+		ok = false;
+	}
+	const ini_section *s = ok ? find_section(idx, sec.name) : NULL;
+	if (s != NULL) {
+		size_t from = lo ? entry_bound(s->first, s->count,
+				from_name.name, false) : 0;
+		size_t to = hi ? entry_bound(s->first, s->count,
+				to_name.name, false) : s->count;
+		r.first = s->first + from;
+		r.count = to > from ? to - from : 0;
+	}
+	if (ok) {
+		fold_done(&from_name);
+		fold_done(&to_name);
+	}
+	fold_done(&sec);
+	return r;
+}
+
+static
+ini_section_range
+section_prefix(
+	const ini_index *idx,
+	const char *prefix
+) {
+	size_t lo = section_bound(idx->sections, idx->section_count,
+			prefix, false);
+	size_t hi = section_bound(idx->sections, idx->section_count,
+			prefix, true);
+	ini_section_range r = { idx->sections + lo, hi > lo ? hi - lo : 0 };
+	return r;
+}
+
+ini_section_range
+ini_index_section_prefix(
+	const ini_index *idx,
+	const char *prefix
+) {
+	ini_section_range r = { NULL, 0 };
+	folded pre;
+	if (!fold_query(idx, prefix, &pre))
+		return r;
+	r = section_prefix(idx, pre.name);
+	fold_done(&pre);
+	return r;
+}
+
+ini_section_range
+ini_index_section_range(
+	const ini_index *idx,
+	const char *lo,
+	const char *hi
+) {
+	ini_section_range r = { NULL, 0 };
+	folded from_name;
+	folded to_name;
+	if (!fold_query(idx, lo, &from_name))
+		return r;
+	if (!fold_query(idx, hi, &to_name)) {
+		fold_done(&from_name);
+		return r;
+	}
+	size_t n = idx->section_count;
+	size_t from = lo ? section_bound(idx->sections, n,
+			from_name.name, false) : 0;
+	size_t to = hi ? section_bound(idx->sections, n,
+			to_name.name, false) : n;
+	r.first = idx->sections + from;
+	r.count = to > from ? to - from : 0;
+	fold_done(&from_name);
+	fold_done(&to_name);
+	return r;
+}
+
+/*
+ * glob_prefix
+ *
+ * copy the literal text ahead of the first wildcard. the caller
+ * frees the result.
+ */
+
+static
+char *
+glob_prefix(
+	const char *pattern
+) {
+	size_t len = strcspn(pattern, "*?");
+	char *prefix = malloc(len + 1);
+	if (prefix == NULL)
+		return NULL;
+	memcpy(prefix, pattern, len);
+	prefix[len] = '\0';
+	return prefix;
+}
+
+size_t
+ini_index_key_glob(
+	const ini_index *idx,
+	const char *section,
+	const char *pattern,
+	fn_entry_visit visit,
+	void *user_data
+) {
+	folded sec;
+	folded pat;
+	if (!fold_query(idx, section, &sec))
+		return 0;
+	if (!fold_query(idx, pattern, &pat)) {
+		fold_done(&sec);
+		return 0;
+	}
+	char *prefix = glob_prefix(pat.name);
+	ini_range r = { NULL, 0 };
+	if (prefix != NULL)
+		r = key_prefix(find_section(idx, sec.name), prefix);
+	free(prefix);
+
+	size_t visited = 0;
+	for (size_t i = 0; i < r.count; i++) {
+		if (!ini_glob_match(pat.name, r.first[i].key_fold))
+			continue;
+		visited += 1;
+		if (visit(&r.first[i], user_data))
+			break;
+	}
+	fold_done(&sec);
+	fold_done(&pat);
+	return visited;
+}
+
+size_t
+ini_index_section_glob(
+	const ini_index *idx,
+	const char *pattern,
+	fn_section_visit visit,
+	void *user_data
+) {
+	folded pat;
+	if (!fold_query(idx, pattern, &pat))
+		return 0;
+	char *prefix = glob_prefix(pat.name);
+	ini_section_range r = { NULL, 0 };
+	if (prefix != NULL)
+		r = section_prefix(idx, prefix);
+	free(prefix);
+
+	size_t visited = 0;
+	for (size_t i = 0; i < r.count; i++) {
+		if (!ini_glob_match(pat.name, r.first[i].name_fold))
+			continue;
+		visited += 1;
+		if (visit(&r.first[i], user_data))
+			break;
+	}
+	fold_done(&pat);
+	return visited;
+}
+
+/*
+ * ini_glob_match
+ *
+ * the usual single star backtracking match. when a character fails
+ * to match, resume just after the most recent '*' and let it swallow
+ * one more character of the text. no recursion.
+ */
+
+bool
+ini_glob_match(
+	const char *pattern,
+	const char *text
+) {
+	const char *p = pattern;
+	const char *t = text;
+	const char *star = NULL;
+	const char *mark = NULL;
+
+	while (*t) {
+		if (*p == '*') {
+			star = p;
+			p += 1;
+			mark = t;
+		} else if (*p == '?' || *p == *t) {
+			p += 1;
+			t += 1;
+		} else if (star != NULL) {
+			p = star + 1;
+			mark += 1;
+			t = mark;
+		} else
+			return false;
+	}
+	while (*p == '*')
+		p += 1;
+	return *p == '\0';
+}
+
+/* iniindex.c ends here */
@@ -0,0 +1,306 @@
+/* iniindex.h -- an ordered index over the pairs of a parsed ini file */
+
+#ifndef INIINDEX_H
+#define INIINDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "inifold.h"
+#include "iniparser.h"
+
+/*
+ * the index is a sorted array of every section:key:value triple
+ * reported by parse_ini, ordered by section, then key, then the
+ * order the pair appeared in the file. a second sorted array holds
+ * each distinct section name and the run of entries it owns.
+ *
+ * all queries are binary searches that return a contiguous run of
+ * the sorted arrays, so a query costs O(log n) to locate and O(k)
+ * to walk. iteration order is plain byte order (strcmp) and is the
+ * same from run to run.
+ *
+ * glob patterns understand '*' (any run of characters) and '?' (any
+ * single character). the literal text before the first wildcard is
+ * used to narrow the search to a prefix run before matching.
+ *
+ * an index created with a fold mode (see inifold.h) ignores case.
+ * each entry keeps its names as spelled in the file, for output,
+ * and their folded forms, which are folded once as the entry is
+ * added. sorting, grouping into sections, and every query use the
+ * folded names, and query arguments are folded the same way, so
+ * [Network] and [network] are one section. without a fold mode the
+ * folded names are the spelled ones.
+ *
+ * ini_index_get is a hash lookup on a hash of the folded section
+ * and key stored in each entry, so a lookup that ignores case costs
+ * the same as an exact one.
+ */
+
+typedef struct ini_entry {
+	const char *section;
+	const char *key;
+	const char *value;
+	size_t seq;           /* order pair was added, for stability */
+	const char *section_fold;
+	const char *key_fold;
+	uint64_t hash;        /* of section_fold and key_fold        */
+} ini_entry;
+
+/* name is the spelling of one of the section's appearances. */
+
+typedef struct ini_section {
+	const char *name;
+	const ini_entry *first;  /* first entry of this section */
+	size_t count;            /* number of entries           */
+	const char *name_fold;
+} ini_section;
+
+/* a run of consecutive entries in the index. */
+
+typedef struct ini_range {
+	const ini_entry *first;
+	size_t count;
+} ini_range;
+
+/* a run of consecutive sections in the index. */
+
+typedef struct ini_section_range {
+	const ini_section *first;
+	size_t count;
+} ini_section_range;
+
+typedef struct ini_index ini_index;
+
+/*
+ * visitor for glob queries, mirrors fn_callback: return true to
+ * stop the walk early.
+ */
+
+typedef
+bool
+(*fn_entry_visit)(
+	const ini_entry *entry,
+	void *user_data
+);
+
+typedef
+bool
+(*fn_section_visit)(
+	const ini_section *section,
+	void *user_data
+);
+
+/*
+ * ini_index_create
+ *
+ * create an empty index. pairs are added with ini_index_add, or
+ * by passing ini_index_callback and the index to parse_ini. the
+ * index can not be queried until ini_index_finish is called.
+ *
+ * return: a new index or NULL if memory is exhausted
+ */
+
+ini_index *
+ini_index_create(void);
+
+/*
+ * ini_index_create_ex
+ *
+ * create an empty index that folds names.
+ *
+ * in    : INI_FOLD mode
+ * return: a new index or NULL if memory is exhausted
+ */
+
+ini_index *
+ini_index_create_ex(
+	int fold
+);
+
+/*
+ * ini_index_add
+ *
+ * copy a section:key:value triple into an unfinished index.
+ *
+ * in/out: the index
+ * in    : section, key, and value strings
+ * return: false if memory is exhausted
+ */
+
+bool
+ini_index_add(
+	ini_index *idx,
+	const char *section,
+	const char *key,
+	const char *value
+);
+
+/*
+ * ini_index_callback
+ *
+ * an fn_callback that adds each pair to the ini_index passed as
+ * user_data. it asks the parser to stop if memory is exhausted,
+ * ini_index_finish will then report the failure.
+ */
+
+bool
+ini_index_callback(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+);
+
+/*
+ * ini_index_finish
+ *
+ * sort the entries and build the section table. after this the
+ * index is read only.
+ *
+ * in/out: the index
+ * return: false if an earlier add failed or memory is exhausted
+ */
+
+bool
+ini_index_finish(
+	ini_index *idx
+);
+
+/*
+ * ini_index_build
+ *
+ * convenience: parse a stream into a new finished index.
+ *
+ * in/out: file stream on an ini file
+ * return: a finished index, or NULL on a parse or memory error
+ */
+
+ini_index *
+ini_index_build(
+	FILE *ini_file
+);
+
+/* the same, into an index that folds names. */
+
+ini_index *
+ini_index_build_ex(
+	FILE *ini_file,
+	int fold
+);
+
+void
+ini_index_free(
+	ini_index *idx
+);
+
+/* every entry and every section, in index order. */
+
+ini_range
+ini_index_entries(
+	const ini_index *idx
+);
+
+ini_section_range
+ini_index_sections(
+	const ini_index *idx
+);
+
+/*
+ * ini_index_get
+ *
+ * find the value for section:key. if the key was repeated, the
+ * last occurrence in the file is returned.
+ *
+ * return: the entry or NULL if not found
+ */
+
+const ini_entry *
+ini_index_get(
+	const ini_index *idx,
+	const char *section,
+	const char *key
+);
+
+/* the section named, or NULL. */
+
+const ini_section *
+ini_index_section(
+	const ini_index *idx,
+	const char *section
+);
+
+/*
+ * key queries within one section.
+ *
+ * prefix: all keys that start with prefix.
+ * range : all keys with lo <= key < hi. a NULL bound is open.
+ * glob  : visit each key matching pattern, returns the number
+ *         of entries visited.
+ */
+
+ini_range
+ini_index_key_prefix(
+	const ini_index *idx,
+	const char *section,
+	const char *prefix
+);
+
+ini_range
+ini_index_key_range(
+	const ini_index *idx,
+	const char *section,
+	const char *lo,
+	const char *hi
+);
+
+size_t
+ini_index_key_glob(
+	const ini_index *idx,
+	const char *section,
+	const char *pattern,
+	fn_entry_visit visit,
+	void *user_data
+);
+
+/* the same three queries over section names. */
+
+ini_section_range
+ini_index_section_prefix(
+	const ini_index *idx,
+	const char *prefix
+);
+
+ini_section_range
+ini_index_section_range(
+	const ini_index *idx,
+	const char *lo,
+	const char *hi
+);
+
+size_t
+ini_index_section_glob(
+	const ini_index *idx,
+	const char *pattern,
+	fn_section_visit visit,
+	void *user_data
+);
+
+/*
+ * ini_glob_match
+ *
+ * does text match a '*' and '?' glob pattern. exposed for clients
+ * that want to filter the same way the index does.
+ */
+
+bool
+ini_glob_match(
+	const char *pattern,
+	const char *text
+);
+
+#endif /* INIINDEX_H */
+
+/* iniindex.h ends here */
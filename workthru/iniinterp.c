@@ -0,0 +1,726 @@
+/* iniinterp.c -- ${section:key} interpolation over an ini index */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+#include "iniinterp.h"
+
+/*
+ * every key that has been asked for, or referenced by something that
+ * was asked for, gets a node. a node keeps its own copy of the raw
+ * value so that a reload can tell whether it changed, the references
+ * found in that value, the cached expansion, and the list of nodes
+ * whose values reference it (its dependents). a reload discards the
+ * expansion of a changed node and walks the dependents to discard
+ * theirs. nothing else is touched.
+ *
+ * a node for a key that is not in the index has a NULL raw value.
+ * it is kept so that if the key shows up in a later reload the keys
+ * that referenced it are retried.
+ *
+ * node states:
+ *
+ * NEW    - nothing cached, references not yet scanned
+ * ACTIVE - references scanned, waiting on them to be expanded. the
+ *          active nodes are exactly the current chain of references
+ *          being followed, so reaching an active node again is a
+ *          cycle.
+ * DONE   - expansion cached
+ * FAILED - the error is cached
+ */
+
+#define NODE_NEW    0
+#define NODE_ACTIVE 1
+#define NODE_DONE   2
+#define NODE_FAILED 3
+
+#define REF_DOLLAR  0   /* $$                 */
+#define REF_ENV     1   /* ${ENV:name}        */
+#define REF_KEY     2   /* ${section:key}     */
+
+typedef struct node node;
+
+typedef struct ref {
+	int kind;
+	size_t start;       /* span of the reference in the raw value */
+	size_t end;
+	size_t name;        /* span of the env variable name          */
+	size_t name_end;
+	node *target;
+} ref;
+
+struct node {
+	char *section;      /* section and key share one block */
+	char *key;
+	uint64_t hash;
+	char *raw;
+	char *expanded;
+	char *error;
+	int state;
+	int status;
+	ref *refs;
+	size_t ref_count;
+	node **rdeps;
+	size_t rdep_count;
+	size_t rdep_capacity;
+};
+
+struct ini_interp {
+	const ini_index *idx;
+	node **table;       /* open addressing, capacity a power of 2 */
+	size_t capacity;
+	size_t count;
+	node **stack;
+	size_t depth;
+	size_t stack_capacity;
+	char error[256];
+};
+
+/*
+ * copy_string
+ *
+ * strdup is not part of c18.
+ */
+
+static
+char *
+copy_string(
+	const char *s
+) {
+	size_t len = strlen(s) + 1;
+	char *p = malloc(len);
+	if (p != NULL)
+		memcpy(p, s, len);
+	return p;
+}
+
+ini_interp *
+ini_interp_create(
+	const ini_index *idx
+) {
+	ini_interp *interp = calloc(1, sizeof(ini_interp));
+	if (interp == NULL)
+		return NULL;
+	interp->idx = idx;
+	interp->capacity = 64;
+	interp->table = calloc(interp->capacity, sizeof(node *));
+	if (interp->table == NULL) {
+		free(interp);
+		return NULL;
+	}
+	return interp;
+}
+
+/*
+ * forget_refs
+ *
+ * drop the scanned references of a node, removing the node from the
+ * dependent list of each target.
+ */
+
+static
+void
+forget_refs(
+	node *n
+) {
+	for (size_t i = 0; i < n->ref_count; i++) {
+		node *t = n->refs[i].target;
+		if (t == NULL)
+			continue;
+		for (size_t j = 0; j < t->rdep_count; j++) {
+			if (t->rdeps[j] == n) {
+				t->rdeps[j] = t->rdeps[t->rdep_count-1];
+				t->rdep_count -= 1;
+				break;
+			}
+		}
+	}
+	free(n->refs);
+	n->refs = NULL;
+	n->ref_count = 0;
+}
+
+static
+void
+free_node(
+	node *n
+) {
+	free(n->section);
+	free(n->raw);
+	free(n->expanded);
+	free(n->error);
+	free(n->refs);
+	free(n->rdeps);
+	free(n);
+}
+
+void
+ini_interp_free(
+	ini_interp *interp
+) {
+	if (interp == NULL)
+		return;
+	for (size_t i = 0; i < interp->capacity; i++)
+		if (interp->table[i] != NULL)
+			free_node(interp->table[i]);
+	free(interp->table);
+	free(interp->stack);
+	free(interp);
+}
+
+static
+bool
+push(
+	ini_interp *interp,
+	node *n
+) {
+	if (interp->depth == interp->stack_capacity) {
+		size_t capacity = interp->stack_capacity ? interp->stack_capacity * 2 : 32;
+		node **p = realloc(interp->stack, capacity * sizeof(node *));
+		if (p == NULL)
+			return false;
+		interp->stack = p;
+		interp->stack_capacity = capacity;
+	}
+	interp->stack[interp->depth] = n;
+	interp->depth += 1;
+	return true;
+}
+
+static
+bool
+grow_table(
+	ini_interp *interp
+) {
+	size_t capacity = interp->capacity * 2;
+	node **table = calloc(capacity, sizeof(node *));
+	if (table == NULL)
+		return false;
+	for (size_t i = 0; i < interp->capacity; i++) {
+		node *n = interp->table[i];
+		if (n == NULL)
+			continue;
+		size_t slot = n->hash & (capacity - 1);
+		while (table[slot] != NULL)
+			slot = (slot + 1) & (capacity - 1);
+		table[slot] = n;
+	}
+	free(interp->table);
+	interp->table = table;
+	interp->capacity = capacity;
+	return true;
+}
+
+/*
+ * find_node
+ *
+ * look up the node for a section and key given as counted strings,
+ * creating it if needed. a new node copies its raw value from the
+ * index.
+ *
+ * return: the node or NULL if memory is exhausted
+ */
+
+static
+node *
+find_node(
+	ini_interp *interp,
+	const char *section,
+	size_t seclen,
+	const char *key,
+	size_t keylen
+) {
+	uint64_t h = ini_hash_bytes(section, seclen, INI_HASH_SEED);
+	h = ini_hash_bytes("", 1, h);
+	h = ini_hash_bytes(key, keylen, h);
+
+	size_t mask = interp->capacity - 1;
+	size_t slot = h & mask;
+	for (node *n; (n = interp->table[slot]) != NULL; slot = (slot + 1) & mask) {
+		if (n->hash == h
+			&& strncmp(n->section, section, seclen) == 0
+			&& n->section[seclen] == '\0'
+			&& strncmp(n->key, key, keylen) == 0
+			&& n->key[keylen] == '\0')
+			return n;
+	}
+
+	node *n = calloc(1, sizeof(node));
+	if (n == NULL)
+		return NULL;
+	n->section = malloc(seclen + keylen + 2);
+	if (n->section == NULL) {
+		free(n);
+		return NULL;
+	}
+	memcpy(n->section, section, seclen);
+	n->section[seclen] = '\0';
+	n->key = n->section + seclen + 1;
+	memcpy(n->key, key, keylen);
+	n->key[keylen] = '\0';
+	n->hash = h;
+
+	const ini_entry *e = ini_index_get(interp->idx, n->section, n->key);
+	if (e != NULL && (n->raw = copy_string(e->value)) == NULL) {
+		free_node(n);
+		return NULL;
+	}
+
+	/* keep the table at most half full. */
+
+	if ((interp->count + 1) * 2 > interp->capacity) {
+		if (!grow_table(interp)) {
+			free_node(n);
+			return NULL;
+		}
+		mask = interp->capacity - 1;
+		slot = h & mask;
+		while (interp->table[slot] != NULL)
+			slot = (slot + 1) & mask;
+	}
+	interp->table[slot] = n;
+	interp->count += 1;
+	return n;
+}
+
+static
+bool
+add_rdep(
+	node *target,
+	node *dependent
+) {
+	if (target->rdep_count == target->rdep_capacity) {
+		size_t capacity = target->rdep_capacity ? target->rdep_capacity * 2 : 4;
+		node **p = realloc(target->rdeps, capacity * sizeof(node *));
+		if (p == NULL)
+			return false;
+		target->rdeps = p;
+		target->rdep_capacity = capacity;
+	}
+	target->rdeps[target->rdep_count] = dependent;
+	target->rdep_count += 1;
+	return true;
+}
+
+/*
+ * scan_refs
+ *
+ * find the references in a node's raw value, create nodes for the
+ * keys they name, and register this node as their dependent. the
+ * raw value is walked once.
+ */
+
+static
+bool
+scan_refs(
+	ini_interp *interp,
+	node *n
+) {
+	const char *raw = n->raw;
+	size_t capacity = 0;
+
+	for (size_t i = 0; raw[i] != '\0'; i++) {
+		if (raw[i] != '$')
+			continue;
+
+		ref r = { 0 };
+		r.start = i;
+		if (raw[i+1] == '$') {
+			r.kind = REF_DOLLAR;
+			r.end = i + 2;
+		} else if (raw[i+1] == '{') {
+			const char *close = strchr(raw + i + 2, '}');
+			if (close == NULL)
+				break;  /* unterminated, the rest is literal */
+			const char *inner = raw + i + 2;
+			size_t len = close - inner;
+			const char *colon = memchr(inner, ':', len);
+			r.end = close - raw + 1;
+			if (colon != NULL && colon - inner == 3
+				&& strncmp(inner, "ENV", 3) == 0) {
+				r.kind = REF_ENV;
+				r.name = colon - raw + 1;
+				r.name_end = close - raw;
+			} else {
+				r.kind = REF_KEY;
+				if (colon != NULL)
+					r.target = find_node(interp, inner, colon - inner,
+							colon + 1, close - colon - 1);
+				else
+					r.target = find_node(interp, n->section,
+							strlen(n->section), inner, len);
+				if (r.target == NULL || !add_rdep(r.target, n))
+					return false;
+			}
+		} else
+			continue;
+
+		if (n->ref_count == capacity) {
+			capacity = capacity ? capacity * 2 : 4;
+			ref *p = realloc(n->refs, capacity * sizeof(ref));
+			if (p == NULL) {
+				if (r.target != NULL)
+					r.target->rdep_count -= 1;
+				return false;
+			}
+			n->refs = p;
+		}
+		n->refs[n->ref_count] = r;
+		n->ref_count += 1;
+		i = r.end - 1;
+	}
+	return true;
+}
+
+static
+void
+fail_node(
+	node *n,
+	int status,
+	const char *error
+) {
+	n->state = NODE_FAILED;
+	n->status = status;
+	free(n->error);
+	n->error = copy_string(error);
+}
+
+/*
+ * fail_cycle
+ *
+ * node 'back' is active and was referenced again. every active node
+ * from 'back' to the top of the stack is on the cycle. describe the
+ * cycle and fail all of them.
+ */
+
+static
+void
+fail_cycle(
+	ini_interp *interp,
+	node *back
+) {
+	size_t from = interp->depth;
+	while (from > 0 && interp->stack[from-1] != back)
+		from -= 1;
+	from -= 1;
+
+	char *msg = interp->error;
+	size_t room = sizeof(interp->error);
+	int used = snprintf(msg, room, "cycle: %s:%s", back->section, back->key);
+	for (size_t i = from + 1; i < interp->depth; i++) {
+		node *n = interp->stack[i];
+		if (n->state != NODE_ACTIVE || used < 0 || (size_t)used >= room)
+			continue;
+		used += snprintf(msg + used, room - used, " -> %s:%s",
+				n->section, n->key);
+	}
+	if (used >= 0 && (size_t)used < room)
+		snprintf(msg + used, room - used, " -> %s:%s",
+			back->section, back->key);
+
+	for (size_t i = from; i < interp->depth; i++)
+		if (interp->stack[i]->state == NODE_ACTIVE)
+			fail_node(interp->stack[i], INI_INTERP_CYCLE, msg);
+}
+
+/*
+ * finish_node
+ *
+ * all the references of an active node are resolved. build the
+ * expansion, or inherit the failure of a reference.
+ */
+
+static
+bool
+finish_node(
+	ini_interp *interp,
+	node *n
+) {
+	size_t len = strlen(n->raw);
+	size_t out = len;
+
+	for (size_t i = 0; i < n->ref_count; i++) {
+		ref *r = &n->refs[i];
+		out -= r->end - r->start;
+		if (r->kind == REF_DOLLAR) {
+			out += 1;
+		} else if (r->kind == REF_ENV) {
+			char name[256];
+			size_t namelen = r->name_end - r->name;
+			if (namelen >= sizeof(name))
+				namelen = sizeof(name) - 1;
+			memcpy(name, n->raw + r->name, namelen);
+			name[namelen] = '\0';
+			const char *env = getenv(name);
+			out += env ? strlen(env) : 0;
+		} else if (r->target->raw == NULL) {
+			snprintf(interp->error, sizeof(interp->error),
+				"undefined: %s:%s references %s:%s",
+				n->section, n->key, r->target->section, r->target->key);
+			fail_node(n, INI_INTERP_UNDEFINED, interp->error);
+			return true;
+		} else if (r->target->state == NODE_FAILED) {
+			fail_node(n, r->target->status, r->target->error);
+			return true;
+		} else
+			out += strlen(r->target->expanded);
+	}
+
+	char *expanded = malloc(out + 1);
+	if (expanded == NULL)
+		return false;
+
+	char *p = expanded;
+	size_t at = 0;
+	for (size_t i = 0; i < n->ref_count; i++) {
+		ref *r = &n->refs[i];
+		memcpy(p, n->raw + at, r->start - at);
+		p += r->start - at;
+		at = r->end;
+		const char *with = "$";
+		if (r->kind == REF_ENV) {
+			char name[256];
+			size_t namelen = r->name_end - r->name;
+			if (namelen >= sizeof(name))
+				namelen = sizeof(name) - 1;
+			memcpy(name, n->raw + r->name, namelen);
+			name[namelen] = '\0';
+			with = getenv(name);
+			if (with == NULL)
+				with = "";
+		} else if (r->kind == REF_KEY)
+			with = r->target->expanded;
+		size_t wlen = strlen(with);
+		memcpy(p, with, wlen);
+		p += wlen;
+	}
+	memcpy(p, n->raw + at, len - at);
+	p[len - at] = '\0';
+
+	n->expanded = expanded;
+	n->state = NODE_DONE;
+	n->status = INI_INTERP_OK;
+	return true;
+}
+
+/*
+ * ini_interp_get
+ *
+ * a depth first walk over the references with an explicit stack.
+ * a node is pushed when first needed. when it reaches the top it
+ * becomes active and pushes the references it needs. when it reaches
+ * the top again they are all resolved and it can be finished.
+ */
+
+const char *
+ini_interp_get(
+	ini_interp *interp,
+	const char *section,
+	const char *key,
+	int *status
+) {
+	int dummy;
+	if (status == NULL)
+		status = &dummy;
+
+	node *want = find_node(interp, section, strlen(section), key, strlen(key));
+	if (want == NULL) {
+		snprintf(interp->error, sizeof(interp->error), "out of memory");
+		*status = INI_INTERP_NOMEM;
+		return NULL;
+	}
+	if (want->raw == NULL) {
+		snprintf(interp->error, sizeof(interp->error),
+			"not found: %s:%s", section, key);
+		*status = INI_INTERP_NOT_FOUND;
+		return NULL;
+	}
+
+	interp->depth = 0;
+	if (want->state == NODE_NEW && !push(interp, want))
+		goto nomem;
+
+	while (interp->depth > 0) {
+		node *n = interp->stack[interp->depth-1];
+		if (n->state == NODE_DONE || n->state == NODE_FAILED) {
+			interp->depth -= 1;
+			continue;
+		}
+
+		if (n->state == NODE_NEW) {
+			n->state = NODE_ACTIVE;
+			if (!scan_refs(interp, n))
+				goto nomem;
+			bool waiting = false;
+			for (size_t i = 0; i < n->ref_count; i++) {
+				node *t = n->refs[i].target;
+				if (t == NULL || t->raw == NULL)
+					continue;
+				if (t->state == NODE_ACTIVE) {
+					fail_cycle(interp, t);
+					break;
+				}
+				if (t->state == NODE_NEW) {
+					if (!push(interp, t))
+						goto nomem;
+					waiting = true;
+				}
+			}
+			if (waiting || n->state == NODE_FAILED)
+				continue;
+		}
+
+		if (!finish_node(interp, n))
+			goto nomem;
+		interp->depth -= 1;
+	}
+
+	*status = want->status;
+	if (want->state == NODE_FAILED) {
+		snprintf(interp->error, sizeof(interp->error), "%s", want->error);
+		return NULL;
+	}
+	return want->expanded;
+
+nomem:
+	/* leave nothing half done. active nodes go back to new. */
+	for (size_t i = 0; i < interp->depth; i++) {
+		node *n = interp->stack[i];
+		if (n->state == NODE_ACTIVE) {
+			forget_refs(n);
+			n->state = NODE_NEW;
+		}
+	}
+	interp->depth = 0;
+	snprintf(interp->error, sizeof(interp->error), "out of memory");
+	*status = INI_INTERP_NOMEM;
+	return NULL;
+}
+
+const char *
+ini_interp_error(
+	const ini_interp *interp
+) {
+	return interp->error;
+}
+
+/*
+ * reset_node
+ *
+ * discard whatever a node has cached and return it to new.
+ */
+
+static
+void
+reset_node(
+	node *n
+) {
+	forget_refs(n);
+	free(n->expanded);
+	n->expanded = NULL;
+	free(n->error);
+	n->error = NULL;
+	n->state = NODE_NEW;
+	n->status = INI_INTERP_OK;
+}
+
+/*
+ * reset_all
+ *
+ * discard every cached value. used when the dependents of a change
+ * can't be followed for lack of memory, so that nothing built from
+ * an old raw value survives.
+ */
+
+static
+size_t
+reset_all(
+	ini_interp *interp
+) {
+	size_t discarded = 0;
+	interp->depth = 0;
+	for (size_t i = 0; i < interp->capacity; i++) {
+		node *n = interp->table[i];
+		if (n == NULL || n->state == NODE_NEW)
+			continue;
+		reset_node(n);
+		discarded += 1;
+	}
+	return discarded;
+}
+
+/*
+ * invalidate
+ *
+ * the raw value of 'changed' is different. reset it and everything
+ * that depends on it, directly or not. a node that is already new
+ * has nothing cached and neither can its dependents, so the walk
+ * stops there. if the walk's stack can't grow the whole cache is
+ * reset instead.
+ */
+
+static
+size_t
+invalidate(
+	ini_interp *interp,
+	node *changed
+) {
+	size_t discarded = 0;
+	interp->depth = 0;
+
+	for (size_t i = 0; i < changed->rdep_count; i++)
+		if (!push(interp, changed->rdeps[i]))
+			return reset_all(interp);
+	if (changed->state != NODE_NEW) {
+		reset_node(changed);
+		discarded += 1;
+	}
+
+	while (interp->depth > 0) {
+		node *n = interp->stack[interp->depth-1];
+		interp->depth -= 1;
+		if (n->state == NODE_NEW)
+			continue;
+		for (size_t i = 0; i < n->rdep_count; i++)
+			if (!push(interp, n->rdeps[i]))
+				return discarded + reset_all(interp);
+		reset_node(n);
+		discarded += 1;
+	}
+	return discarded;
+}
+
+size_t
+ini_interp_reload(
+	ini_interp *interp,
+	const ini_index *idx
+) {
+	size_t discarded = 0;
+	interp->idx = idx;
+
+	for (size_t i = 0; i < interp->capacity; i++) {
+		node *n = interp->table[i];
+		if (n == NULL)
+			continue;
+		const ini_entry *e = ini_index_get(idx, n->section, n->key);
+		const char *raw = e ? e->value : NULL;
+		if (raw == NULL && n->raw == NULL)
+			continue;
+		if (raw != NULL && n->raw != NULL && strcmp(raw, n->raw) == 0)
+			continue;
+
+		/* if the copy fails the node reads as missing, which is
+		 * reported to the client as not found. */
+
+		free(n->raw);
+		n->raw = raw ? copy_string(raw) : NULL;
+		discarded += invalidate(interp, n);
+	}
+	return discarded;
+}
+
+/* iniinterp.c ends here */
@@ -0,0 +1,110 @@
+/* iniinterp.h -- ${section:key} interpolation over an ini index */
+
+#ifndef INIINTERP_H
+#define INIINTERP_H
+
+#include <stdbool.h>
+
+#include "iniindex.h"
+
+/*
+ * an opt-in layer over a finished ini_index that expands references
+ * in values:
+ *
+ *   ${section:key}   the value of key in section
+ *   ${key}           the value of key in the same section
+ *   ${ENV:name}      the environment variable name, empty if unset
+ *   $$               a literal $
+ *
+ * a '${' without a closing '}' is left as is. referenced values are
+ * expanded in turn.
+ *
+ * nothing is expanded until it is asked for. each expansion is kept
+ * and reused until a reload changes the raw value of the key or of
+ * anything it depends on. a reference cycle is reported as an error
+ * for every key on, or depending on, the cycle.
+ *
+ * expansion uses an explicit stack, not recursion, so a deep chain
+ * of references costs time in proportion to its length and will not
+ * run out of stack.
+ */
+
+#define INI_INTERP_OK         0
+#define INI_INTERP_NOT_FOUND  1   /* the key asked for does not exist */
+#define INI_INTERP_UNDEFINED  2   /* a reference names a missing key  */
+#define INI_INTERP_CYCLE      3   /* a reference cycle was found      */
+#define INI_INTERP_NOMEM      4
+
+typedef struct ini_interp ini_interp;
+
+/*
+ * ini_interp_create
+ *
+ * create an interpolation layer over an index. the index must stay
+ * alive until it is replaced by ini_interp_reload or the layer is
+ * freed.
+ *
+ * return: the layer or NULL if memory is exhausted
+ */
+
+ini_interp *
+ini_interp_create(
+	const ini_index *idx
+);
+
+void
+ini_interp_free(
+	ini_interp *interp
+);
+
+/*
+ * ini_interp_get
+ *
+ * the expanded value of section:key.
+ *
+ * in/out: the layer
+ * in    : section and key
+ * out   : an INI_INTERP status code, may be NULL
+ * return: the expansion, or NULL on error. the string belongs to
+ *         the layer and is good until the next reload or free.
+ *
+ * ini_interp_error describes the most recent error, for example
+ * "cycle: a:x -> b:y -> a:x".
+ */
+
+const char *
+ini_interp_get(
+	ini_interp *interp,
+	const char *section,
+	const char *key,
+	int *status
+);
+
+const char *
+ini_interp_error(
+	const ini_interp *interp
+);
+
+/*
+ * ini_interp_reload
+ *
+ * switch the layer to a newly parsed index. cached expansions are
+ * kept except for keys whose raw value changed (or appeared or
+ * disappeared) and every key that depends on them. if memory runs
+ * out while following the dependents, every cached expansion is
+ * discarded, so nothing expanded from an old value is served.
+ *
+ * in/out: the layer
+ * in    : the new index, the old one may be freed after this
+ * return: the number of cached expansions discarded
+ */
+
+size_t
+ini_interp_reload(
+	ini_interp *interp,
+	const ini_index *idx
+);
+
+#endif /* INIINTERP_H */
+
+/* iniinterp.h ends here */
@@ -5,8 +5,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
+#include "inidupes.h"
+#include "inienc.h"
+#include "inifold.h"
+#include "inihash.h"
 #include "iniparser.h"
+#include "inischema.h"
 
 /*
  * this is inspired by source in a paper by chloe kudryavtsev _simply
@@ -46,16 +52,237 @@
  */
 
 /*
- * functions return one of the following status codes. remember that
- * the standard library says that if an error occurs on a file stream
- * eof will also be set. this means that ferror must be checked before
- * feof.
+ * functions return one of the following status codes. as with a file
+ * stream, if a read error occurs on the scanner eof will also be set.
+ * this means that sc_error must be checked before sc_eof.
  */
 
 #define STAT_ERROR  -1
 #define STAT_EOF     0
 #define STAT_OK      1
 
+/*
+ * the scanner
+ *
+ * the parser reads through a block buffer instead of calling fgetc
+ * for every byte. the buffer is filled by a reader function, which
+ * lets the same parse run over a FILE, a decompressor, or anything
+ * else that can hand over blocks of bytes.
+ *
+ * sc_getc, sc_ungetc, sc_eof, and sc_error stand in for fgetc,
+ * ungetc, feof, and ferror. only the character just read may be
+ * pushed back, which is all the parser ever does.
+ *
+ * the scanner counts lines as it goes so that problems can be
+ * reported with a line and column. read_next notes where the last
+ * expression it read started, and for a pair where its value
+ * started, and whether it was a section header.
+ *
+ * runs of whitespace and the rest of a line (a value, a comment,
+ * or whatever is past the end of a full buffer) are scanned in the
+ * block with a loop or memchr rather than a byte at a time through
+ * sc_getc, so a long line costs little more than reading it.
+ *
+ * if max_line is set, a line longer than that sets 'limit'. a line
+ * still going when the buffer needs refilling is caught then and
+ * the scanner reports end of input, so the rest of it is never
+ * read.
+ */
+
+#define SCAN_BUFLEN 65536
+
+typedef struct scanner {
+	fn_reader reader;
+	void *handle;
+	size_t pos;
+	size_t len;
+	bool eof;
+	bool error;
+	size_t base;             /* offset in input of buffer[0] */
+	long line;               /* current line, from 1         */
+	size_t line_start;       /* offset of current line       */
+	size_t prev_line_start;  /* in case a \n is pushed back  */
+	bool header;             /* last expression was [header] */
+	long expr_line;          /* where it started             */
+	long expr_column;
+	long value_column;
+	size_t expr_start;       /* offset of its line           */
+	size_t value_start;      /* offset of a pair's value     */
+	size_t max_line;         /* 0 for no limit               */
+	bool limit;              /* max_line was exceeded        */
+	char buffer[SCAN_BUFLEN];
+} scanner;
+
+/*
+ * sc_fill
+ *
+ * the buffer is used up, ask the reader for more.
+ *
+ * return: true if there are bytes to scan
+ */
+
+static
+bool
+sc_fill(
+	scanner *sc
+) {
+	if (sc->eof)
+		return false;
+	if (sc->max_line != 0
+		&& sc->base + sc->len - sc->line_start > sc->max_line) {
+		sc->limit = true;
+		sc->eof = true;
+		return false;
+	}
+	long got = sc->reader(sc->handle, sc->buffer, SCAN_BUFLEN);
+	sc->base += sc->len;
+	sc->pos = 0;
+	sc->len = got > 0 ? got : 0;
+	if (got < 0)
+		sc->error = true;
+	if (got <= 0)
+		sc->eof = true;
+	return got > 0;
+}
+
+/*
+ * sc_newline
+ *
+ * the \n before pos was just read. start a new line.
+ */
+
+static
+void
+sc_newline(
+	scanner *sc
+) {
+	size_t next = sc->base + sc->pos;
+	if (sc->max_line != 0 && next - 1 - sc->line_start > sc->max_line)
+		sc->limit = true;
+	sc->line += 1;
+	sc->prev_line_start = sc->line_start;
+	sc->line_start = next;
+}
+
+static
+int
+sc_getc(
+	scanner *sc
+) {
+	if (sc->pos == sc->len && !sc_fill(sc))
+		return EOF;
+	int c = (unsigned char)sc->buffer[sc->pos++];
+	if (c == '\n')
+		sc_newline(sc);
+	return c;
+}
+
+static
+void
+sc_ungetc(
+	scanner *sc
+) {
+	sc->pos -= 1;
+	if (sc->buffer[sc->pos] == '\n') {
+		sc->line -= 1;
+		sc->line_start = sc->prev_line_start;
+	}
+}
+
+/*
+ * sc_take_line
+ *
+ * read the rest of the current line and the \n that ends it,
+ * keeping at most 'room' bytes of it. the \n is not kept and the
+ * bytes are not terminated.
+ *
+ * in/out: scanner
+ * out   : buffer, may be NULL if room is 0
+ * in    : room in buffer
+ * return: bytes placed in buffer
+ *
+ * check sc_error and sc_eof afterwards as with sc_getc. the line
+ * ended with a \n if sc_eof is false.
+ */
+
+static
+size_t
+sc_take_line(
+	scanner *sc,
+	char *buffer,
+	size_t room
+) {
+	size_t got = 0;
+	for (;;) {
+		if (sc->pos == sc->len && !sc_fill(sc))
+			return got;
+		const char *start = sc->buffer + sc->pos;
+		size_t avail = sc->len - sc->pos;
+		const char *nl = memchr(start, '\n', avail);
+		size_t run = nl != NULL ? (size_t)(nl - start) : avail;
+		size_t copy = run < room - got ? run : room - got;
+		if (copy > 0) {
+			memcpy(buffer + got, start, copy);
+			got += copy;
+		}
+		sc->pos += run;
+		if (nl != NULL) {
+			sc->pos += 1;
+			sc_newline(sc);
+			return got;
+		}
+	}
+}
+
+/*
+ * sc_column
+ *
+ * the column, from 1, of the next character to be read.
+ */
+
+static
+long
+sc_column(
+	const scanner *sc
+) {
+	return sc->base + sc->pos - sc->line_start + 1;
+}
+
+static
+bool
+sc_eof(
+	const scanner *sc
+) {
+	return sc->eof && sc->pos == sc->len;
+}
+
+static
+bool
+sc_error(
+	const scanner *sc
+) {
+	return sc->error;
+}
+
+/*
+ * read_file
+ *
+ * the fn_reader for a FILE stream.
+ */
+
+static
+long
+read_file(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	size_t got = fread(buffer, 1, buflen, handle);
+	if (got == 0 && ferror((FILE *)handle))
+		return -1;
+	return got;
+}
+
 /*
  * skip_leading_whitespace
  *
@@ -64,29 +291,32 @@
  *
  * in this program, a newline \n is a delimiter and not whitespace.
  *
- * in/out: file stream
+ * in/out: scanner
  * return: integer STAT code
  *
- * remember that per the standard 'feof' is set for both a genuine eof
+ * remember that, as with feof, sc_eof is set for both a genuine eof
  * and for an error.
  */
 
 static
 int
 skip_leading_whitespace(
-	FILE* f
+	scanner *sc
 ) {
-	int c = fgetc(f);
-	while (!feof(f) && (c == ' ' || c == '\r' || c == '\t'))
-		c = fgetc(f); /* just churning */
+	for (;;) {
+		while (sc->pos < sc->len) {
+			char c = sc->buffer[sc->pos];
+			if (c != ' ' && c != '\r' && c != '\t')
+				return STAT_OK;
+			sc->pos += 1; /* just churning */
+		}
+		if (!sc_fill(sc))
+			break;
+	}
 
-	if (ferror(f))
+	if (sc_error(sc))
 		return STAT_ERROR;
-	if (feof(f))
-		return STAT_EOF;
-
-	ungetc(c, f);
-	return STAT_OK;
+	return STAT_EOF;
 }
 
 /*
@@ -139,7 +369,7 @@ trim_right(
  * reasons a line will be flushed are the line is a comment or there
  * are characters after a [section] declaration.
  *
- * in/out: file stream
+ * in/out: scanner
  * return: STAT_OK or STAT_ERROR
  *
  * an end of file is considered 'ok' here. after the current line is
@@ -151,13 +381,10 @@ trim_right(
 
 static
 int
-flush_line(FILE* f) {
-	int c = '\0';
-
-	while (c = fgetc(f), !feof(f) && c != '\n')
-		;
+flush_line(scanner *sc) {
+	sc_take_line(sc, NULL, 0);
 
-	if (ferror(f))
+	if (sc_error(sc))
 		return STAT_ERROR;
 	return STAT_OK;
 }
@@ -167,7 +394,7 @@ flush_line(FILE* f) {
  *
  * read the section into a buffer.
  *
- * in/out: a file stream
+ * in/out: a scanner
  * in/out: string buffer large enough
  * in    : length of buffer
  * return: STAT_ERROR or STAT_OK or STAT_EOF
@@ -182,7 +409,7 @@ flush_line(FILE* f) {
 static
 int
 read_section(
-	FILE *f,
+	scanner *sc,
 	char *buffer,
 	ssize_t buflen
 ) {
@@ -191,7 +418,7 @@ read_section(
 	bool skipping_ws = true;
 
 	char *p = buffer;
-	while (c = fgetc(f), !feof(f) && (c != '\n' && c != ']')) {
+	while (c = sc_getc(sc), !sc_eof(sc) && (c != '\n' && c != ']')) {
 		if (skipping_ws && (c == ' ' || c == '\r' || c == '\t'))
 			continue;
 		skipping_ws = false;
@@ -205,13 +432,13 @@ read_section(
 	}
 	*p = '\0';
 
-	if (ferror(f))
+	if (sc_error(sc))
 		return STAT_ERROR;
-	if (feof(f))
+	if (sc_eof(sc))
 		return STAT_EOF;
 
 	if (c != '\n')
-		return flush_line(f);
+		return flush_line(sc);
 
 	return STAT_OK;
 }
@@ -225,7 +452,7 @@ read_section(
  *
  * if the line does not have an = after the key, it is an error.
  *
- * in/out: file stream
+ * in/out: scanner
  * in/out: buffer large enough
  * in    : length of buffer
  * return: integer STAT code
@@ -235,7 +462,7 @@ read_section(
 static
 int
 read_key(
-	FILE *f,
+	scanner *sc,
 	char *buffer,
 	ssize_t buflen
 ) {
@@ -243,7 +470,7 @@ read_key(
 	int c = 0;
 
 	char *p = buffer;
-	while (c = fgetc(f), !feof(f) && (c != '\n' && c != '=')) {
+	while (c = sc_getc(sc), !sc_eof(sc) && (c != '\n' && c != '=')) {
 		if (len == buflen)
 			continue;
 		len += 1;
@@ -254,9 +481,9 @@ read_key(
 	}
 	*p = '\0';
 
-	if (ferror(f))
+	if (sc_error(sc))
 		return STAT_ERROR;
-	if (feof(f))
+	if (sc_eof(sc))
 		return STAT_EOF;
 
 	if (c != '=')
@@ -276,7 +503,7 @@ read_key(
  *
  * a line 'key = \n' will return an empty string as the value.
  *
- * in/out: file stream
+ * in/out: scanner
  * in/out: buffer to hold the value, must be big enough to hold
  *         INI_VAL_MAXLEN characters
  * return: integer STAT code
@@ -285,26 +512,16 @@ read_key(
 static
 int
 read_value(
-	FILE *f,
+	scanner *sc,
 	char *buffer,
 	ssize_t buflen
 ) {
-	int len = 0;
-	int c = 0;
-
-	char *p = buffer;
-	while (c = fgetc(f), !feof(f) && c != '\n') {
-		if (len == buflen)
-			continue;
-		len += 1;
-		*p = c;
-		p += 1;
-	}
-	*p = '\0';
+	size_t len = sc_take_line(sc, buffer, buflen);
+	buffer[len] = '\0';
 
-	if (ferror(f))
+	if (sc_error(sc))
 		return STAT_ERROR;
-	if (feof(f))
+	if (sc_eof(sc))
 		return STAT_OK;
 	/* eof is ok here. we ignore it and it will be detected on the
 	 * next call to read_next. */
@@ -326,7 +543,7 @@ read_value(
  * # another comment
  * key = value
  *
- * in/out: a file stream
+ * in/out: a scanner
  * in/out: string for section, expected to be INI_SEC_MAXLEN long
  * in/out: string for key, expected to be INI_KEY_MAXLEN long
  * in/out: string for value, expected to be INI_VAL_MAXLEN long
@@ -339,7 +556,7 @@ read_value(
 static
 int
 read_next(
-	FILE *f,
+	scanner *sc,
 	char *section, ssize_t seclen,
 	char *key, ssize_t keylen,
 	char *value, ssize_t vallen
@@ -348,12 +565,17 @@ read_next(
 	int c = '\0';
 
 	do {
-		iostat = skip_leading_whitespace(f);
+		iostat = skip_leading_whitespace(sc);
 		if (iostat != STAT_OK)
 			return iostat;
-		c = fgetc(f);
+		c = sc_getc(sc);
 	} while (c == '\n');
 
+	sc->header = false;
+	sc->expr_line = sc->line;
+	sc->expr_column = sc_column(sc) - 1;
+	sc->expr_start = sc->line_start;
+
 	/* stream should now be positioned on the first non-whitespace
 	 * character of the line to parse. expressions must each be on
 	 * their own line.
@@ -371,7 +593,7 @@ read_next(
 	 * again. */
 
 	if (c == '#' || c == ';') {
-		iostat = flush_line(f);
+		iostat = flush_line(sc);
 		return iostat;
 	}
 
@@ -380,9 +602,10 @@ read_next(
 	 * line is flushed to the next \n. */
 
 	if (c == '[') {
-		memset(key, 0, keylen);
-		memset(value, 0, vallen);
-		iostat = read_section(f, section, seclen);
+		sc->header = true;
+		key[0] = '\0';
+		value[0] = '\0';
+		iostat = read_section(sc, section, seclen);
 		return iostat;
 	}
 
@@ -400,8 +623,8 @@ read_next(
 	 * of the key back on the stream for read_key. read_key reports an
 	 * error if no = is found before \n. */
 
-	ungetc(c, f);
-	iostat = read_key(f, key, keylen);
+	sc_ungetc(sc);
+	iostat = read_key(sc, key, keylen);
 	if (iostat != STAT_OK)
 		return iostat;
 
@@ -409,16 +632,18 @@ read_next(
 	 * that's the start of the value. if we get a lone \n, we'll treat
 	 * it as an empty string. */
 
-	iostat = skip_leading_whitespace(f);
+	iostat = skip_leading_whitespace(sc);
 	if (iostat != STAT_OK)
 		return iostat;
 
-	c = fgetc(f);
+	sc->value_column = sc_column(sc);
+	sc->value_start = sc->base + sc->pos;
+	c = sc_getc(sc);
 	if (c == '\n')
 		return STAT_OK;
 
-	ungetc(c, f);
-	return read_value(f, value, vallen);
+	sc_ungetc(sc);
+	return read_value(sc, value, vallen);
 }
 
 /*
@@ -462,12 +687,180 @@ parse_ini(
 	FILE *ini_file,
 	void *userdata,
 	fn_callback callback
+) {
+	return parse_ini_ex(ini_file, userdata, callback, NULL);
+}
+
+int
+parse_ini_ex(
+	FILE *ini_file,
+	void *userdata,
+	fn_callback callback,
+	const ini_options *options
+) {
+	return parse_ini_reader(read_file, ini_file, userdata, callback, options);
+}
+
+/*
+ * delivery
+ *
+ * where completed pairs go. if a duplicate policy is requested,
+ * pairs go through the duplicate tracker which decides whether and
+ * when to call the client. deliver is an fn_callback so the schema
+ * validator can hand defaults down the same path.
+ */
+
+typedef struct delivery {
+	ini_dupes *dupes;
+	fn_callback callback;
+	void *userdata;
+	ini_fingerprint *fingerprint;
+	bool failed;
+} delivery;
+
+/*
+ * post
+ *
+ * the last step before the client's callback, for pairs from the
+ * parse and from the duplicate tracker alike. adds the pair to the
+ * fingerprint if one was asked for.
+ *
+ * each field is hashed with the previous field's hash as its seed,
+ * so "ab","c" and "a","bc" differ. the ordered fingerprint folds
+ * each pair's hash in turn like an xxh64 round. the unordered one
+ * is their sum, which doesn't care about order.
+ */
+
+static
+bool
+post(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	delivery *d = ctx;
+	ini_fingerprint *fp = d->fingerprint;
+	if (fp != NULL) {
+		uint64_t h = ini_hash_fast(section, strlen(section), 0);
+		h = ini_hash_fast(key, strlen(key), h);
+		h = ini_hash_fast(value, strlen(value), h);
+		fp->ordered += h * 0xc2b2ae3d27d4eb4fULL;
+		fp->ordered = (fp->ordered << 31 | fp->ordered >> 33)
+			* 0x9e3779b185ebca87ULL;
+		fp->unordered += h;
+		fp->pairs += 1;
+	}
+	return d->callback(section, key, value, d->userdata);
+}
+
+static
+bool
+deliver(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	delivery *d = ctx;
+	if (d->dupes == NULL)
+		return post(section, key, value, d);
+
+	int dupstat = ini_dupes_pair(d->dupes, section, key, value, post, d);
+	if (dupstat == INI_DUPES_ERROR)
+		d->failed = true;
+	return dupstat != INI_DUPES_OK;
+}
+
+/*
+ * parse_ini_reader
+ *
+ * the parse proper. see parse_ini above and ini_options in the
+ * header.
+ *
+ * if a schema is given, each header and pair is shown to the
+ * validator first. a pair that fails is not delivered.
+ */
+
+int
+parse_ini_reader(
+	fn_reader reader,
+	void *handle,
+	void *userdata,
+	fn_callback callback,
+	const ini_options *options
 ) {
 	char section[INI_SEC_MAXLEN+1] = {0};
 	char key[INI_KEY_MAXLEN+1] = {0};
 	char value[INI_VAL_MAXLEN+1] = {0};
 
 	int iostat = 0;
+	bool shutdown = false;
+
+	/* a decoder, if asked for, sits between the reader and the
+	 * scanner and hands it UTF-8. */
+
+	ini_decoder *decoder = NULL;
+	if (options != NULL && options->encoding != INI_ENC_RAW) {
+		decoder = ini_decoder_open(reader, handle, options->encoding);
+		if (decoder == NULL)
+			return EXIT_FAILURE;
+		reader = ini_decoder_read;
+		handle = decoder;
+	}
+
+	scanner *sc = malloc(sizeof(scanner));
+	if (sc == NULL) {
+		ini_decoder_close(decoder);
+		return EXIT_FAILURE;
+	}
+	sc->reader = reader;
+	sc->handle = handle;
+	sc->pos = 0;
+	sc->len = 0;
+	sc->eof = false;
+	sc->error = false;
+	sc->base = 0;
+	sc->line = 1;
+	sc->line_start = 0;
+	sc->prev_line_start = 0;
+	sc->max_line = options != NULL ? options->max_line : 0;
+	sc->limit = false;
+
+	int fold = options != NULL ? options->fold : INI_FOLD_NONE;
+	fn_span span = options != NULL ? options->span : NULL;
+	size_t max_sections = options != NULL ? options->max_sections : 0;
+	size_t max_pairs = options != NULL ? options->max_pairs : 0;
+	size_t sections = 0;
+	size_t pairs = 0;
+	bool over_limit = false;
+
+	delivery d = { NULL, callback, userdata, NULL, false };
+	ini_validator *validator = NULL;
+	bool failed = false;
+
+	if (options != NULL && options->fingerprint != NULL) {
+		d.fingerprint = options->fingerprint;
+		d.fingerprint->ordered = 0;
+		d.fingerprint->unordered = 0;
+		d.fingerprint->pairs = 0;
+	}
+
+	if (options != NULL && options->duplicates != INI_DUP_ALL) {
+		d.dupes = ini_dupes_create(options->duplicates, options->separator);
+		failed = d.dupes == NULL;
+	}
+	if (options != NULL && options->schema != NULL && !failed) {
+		validator = ini_validator_create(options->schema,
+				options->schema_error, userdata, deliver, &d);
+		failed = validator == NULL;
+	}
+	if (failed) {
+		ini_dupes_free(d.dupes);
+		ini_decoder_close(decoder);
+		free(sc);
+		return EXIT_FAILURE;
+	}
 
 	/* keep reading until one of the following occurs:
 	 *
@@ -480,19 +873,58 @@ parse_ini(
 	 */
 
 	do {
-		iostat = read_next(ini_file,
+		iostat = read_next(sc,
 				section, INI_SEC_MAXLEN,
 				key, INI_KEY_MAXLEN,
 				value, INI_VAL_MAXLEN);
-		if (iostat != STAT_OK)
+
+		/* a limit stops the parse where it is found, nothing
+		 * more is read or delivered. */
+
+		if (sc->limit)
+			over_limit = true;
+		if (over_limit || iostat != STAT_OK)
+			break;
+		if (sc->header && max_sections != 0)
+			over_limit = ++sections > max_sections;
+		else if (key[0] != '\0' && max_pairs != 0)
+			over_limit = ++pairs > max_pairs;
+		if (over_limit)
 			break;
 
-		/* if key is an empty string, we just read a
-		 * section header. we don't invoke the callback
-		 * until a key:value pair is read. */
+		/* names are folded once, here, so everything after sees
+		 * one spelling. */
+
+		if (fold != INI_FOLD_NONE) {
+			if (sc->header)
+				ini_fold(section, fold);
+			else if (key[0] != '\0')
+				ini_fold(key, fold);
+		}
 
-		if (key[0] == '\0')
+		/* the scanner is just past the line's \n, or at the end
+		 * of the input. */
+
+		if (span != NULL && (sc->header || key[0] != '\0')) {
+			size_t end = sc->base + sc->pos;
+			ini_span where = { section, sc->header ? NULL : key,
+				sc->expr_start, end, sc->header ? end : sc->value_start };
+			span(&where, userdata);
+		}
+
+		/* if key is an empty string, we just read a
+		 * section header or a comment. we don't invoke
+		 * the callback until a key:value pair is read. */
+
+		if (key[0] == '\0') {
+			if (sc->header && validator != NULL
+				&& ini_validator_section(validator, section,
+					sc->expr_line, sc->expr_column)) {
+				shutdown = true;
+				break;
+			}
 			continue;
+		}
 
 		/*******************************
 		 * post to client via callback *
@@ -505,14 +937,40 @@ parse_ini(
 		 * the client returns true if the parse should
 		 * terminate early. */
 
-		bool shutdown = callback(section, key, value, userdata);
-		if (shutdown)
-			break;
-		memset(key, 0, INI_KEY_MAXLEN);
-		memset(value, 0, INI_VAL_MAXLEN);
+		if (validator == NULL
+			|| ini_validator_pair(validator, key, value, sc->expr_line,
+				sc->expr_column, sc->value_column)) {
+			shutdown = deliver(section, key, value, &d);
+			if (d.failed)
+				iostat = STAT_ERROR;
+			if (shutdown)
+				break;
+		}
+		key[0] = '\0';
+		value[0] = '\0';
 
 	} while (iostat == STAT_OK);
 
+	/* the validator fills in defaults and looks for missing keys
+	 * at end of file. held pairs are delivered once the whole
+	 * file has been seen. an early stop by the client skips
+	 * both. */
+
+	if (over_limit)
+		shutdown = true;
+	if (validator != NULL && iostat == STAT_EOF && !shutdown)
+		shutdown = ini_validator_finish(validator, sc->line);
+	if (d.dupes != NULL && iostat == STAT_EOF && !shutdown)
+		ini_dupes_flush(d.dupes, post, &d);
+	if (d.failed || (validator != NULL && ini_validator_failed(validator)))
+		iostat = STAT_ERROR;
+	ini_validator_free(validator);
+	ini_dupes_free(d.dupes);
+	ini_decoder_close(decoder);
+	free(sc);
+
+	if (over_limit)
+		return INI_LIMIT_EXCEEDED;
 	if (iostat == STAT_ERROR)
 		return EXIT_FAILURE;
 
@@ -1,6 +1,10 @@
 /* iniparser.h -- an ini file parser based on one by Chloe Kudryavtsev */
 
+#ifndef INIPARSER_H
+#define INIPARSER_H
+
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #define INI_SEC_MAXLEN 64
@@ -59,4 +63,231 @@ parse_ini(
 	fn_callback callback
 );
 
+/*
+ * options
+ *
+ * optional behavior for parse_ini_ex. a zeroed ini_options gives
+ * the same behavior as parse_ini.
+ *
+ * duplicates: what to do when a section:key pair is seen more
+ *             than once. a section may appear more than once in a
+ *             file, its keys are checked across all appearances.
+ *
+ *   INI_DUP_ALL     - pass every pair to the callback (default)
+ *   INI_DUP_FIRST   - pass only the first occurrence
+ *   INI_DUP_LAST    - pass only the last occurrence
+ *   INI_DUP_COLLECT - pass the key once, the values of all the
+ *                     occurrences joined by 'separator'
+ *   INI_DUP_ERROR   - a duplicate fails the parse
+ *
+ *   FIRST and ERROR call back as the file is read. LAST and COLLECT
+ *   hold all the pairs until the end of the file and then call back
+ *   once per key, grouped by section in order of first appearance.
+ *   any other value fails the parse before anything is read.
+ *
+ * separator : joins values for INI_DUP_COLLECT, '\0' means '\n'.
+ *
+ * schema      : an ini_schema (see inischema.h) to check each pair
+ *               against as it is read. NULL for none.
+ * schema_error: called for each problem the schema finds. the parse
+ *               carries on to find them all, then fails.
+ *
+ * fingerprint : if not NULL, filled with a fingerprint of what the
+ *               parse delivered. see ini_fingerprint below.
+ *
+ * limits, for input that can't be trusted. 0 means no limit. the
+ * parse stops as soon as one is exceeded and returns
+ * INI_LIMIT_EXCEEDED. pairs already delivered stay delivered, held
+ * pairs and schema defaults are not delivered.
+ *
+ * max_line    : longest line in bytes, not counting the \n. a line
+ *               is caught within one 64K block of passing the limit,
+ *               it is never read to its end.
+ * max_sections: most [section] headers, repeats included.
+ * max_pairs   : most key = value pairs read from the file, before
+ *               duplicate handling.
+ *
+ * fold: INI_FOLD_NONE, INI_FOLD_ASCII, or INI_FOLD_UNICODE (see
+ *       inifold.h). section and key names are case folded as they
+ *       are read, so [Network] Timeout and [network] timeout are
+ *       the same pair to the duplicate policy, the schema (declare
+ *       its names folded), the fingerprint, and the callback. the
+ *       callback gets the folded spelling. to keep the spelling from
+ *       the file, leave this off and let an ini_index fold instead.
+ *
+ * encoding: INI_ENC_RAW, INI_ENC_DETECT, or INI_ENC_VALIDATE (see
+ *           inienc.h). RAW reads bytes as they are. DETECT drops a
+ *           byte order mark and transcodes UTF-16 input to UTF-8.
+ *           VALIDATE also fails the parse on malformed UTF-8. line
+ *           and column numbers count in the UTF-8 the parser sees.
+ *
+ * span: if not NULL, called with where each section header and pair
+ *       lies in the input, before any other handling. see ini_span
+ *       below.
+ */
+
+#define INI_LIMIT_EXCEEDED 2
+
+#define INI_DUP_ALL     0
+#define INI_DUP_FIRST   1
+#define INI_DUP_LAST    2
+#define INI_DUP_COLLECT 3
+#define INI_DUP_ERROR   4
+
+/*
+ * schema error callback
+ *
+ * in    : line and column, both from 1, where the problem is
+ * in    : section, and key or NULL if the problem is the section
+ * in    : what is wrong
+ * in/out: user_data, as given to the parser
+ */
+
+typedef
+void
+(*fn_schema_error)(
+	long line,
+	long column,
+	const char *section,
+	const char *key,
+	const char *message,
+	void *user_data
+);
+
+/*
+ * fingerprint
+ *
+ * a hash of the section, key, and value of every pair passed to the
+ * callback, after trimming, duplicate handling, and schema defaults.
+ * comments, blank lines, spacing, and line endings don't change it,
+ * so two files that mean the same thing have the same fingerprint
+ * and a reload can be skipped when it hasn't changed.
+ *
+ * ordered  : changes if the pairs are reordered.
+ * unordered: the same for any order of the same pairs. a section
+ *            that appears twice counts its pairs under its name
+ *            both times, so splitting or merging a section doesn't
+ *            change it either.
+ * pairs    : how many pairs were delivered.
+ *
+ * compare all three, or ordered and pairs when order matters. the
+ * fingerprint of a parse that failed or was stopped by the callback
+ * covers only what was delivered.
+ *
+ * each pair is hashed with xxh64 (see ini_hash_fast in inihash.h)
+ * as it is delivered, there is no second pass over the file.
+ */
+
+typedef struct ini_fingerprint {
+	uint64_t ordered;
+	uint64_t unordered;
+	size_t pairs;
+} ini_fingerprint;
+
+/*
+ * span
+ *
+ * where a section header or a key = value pair lies in the input,
+ * as byte offsets from the start of the input the parser read.
+ * comments and blank lines have no span, they are what lies
+ * between spans.
+ *
+ * start      : the start of the line, leading whitespace included.
+ * end        : just past the \n that ends the line, or the end of
+ *              the input if it has no \n.
+ * value_start: for a pair, the first byte of the value, or the \n
+ *              if the value is empty. otherwise end.
+ *
+ * section is the section the line declares or is in, key is NULL
+ * for a header.
+ */
+
+typedef struct ini_span {
+	const char *section;
+	const char *key;
+	size_t start;
+	size_t end;
+	size_t value_start;
+} ini_span;
+
+typedef
+void
+(*fn_span)(
+	const ini_span *span,
+	void *user_data
+);
+
+struct ini_schema;
+
+typedef struct ini_options {
+	int duplicates;
+	char separator;
+	const struct ini_schema *schema;
+	fn_schema_error schema_error;
+	ini_fingerprint *fingerprint;
+	size_t max_line;
+	size_t max_sections;
+	size_t max_pairs;
+	int fold;
+	int encoding;
+	fn_span span;
+} ini_options;
+
+/*
+ * parse_ini_ex
+ *
+ * parse_ini with options. a NULL options is the same as parse_ini.
+ */
+
+int
+parse_ini_ex(
+	FILE *ini_file,
+	void *userdata,
+	fn_callback callback,
+	const ini_options *options
+);
+
+/*
+ * reader
+ *
+ * the parser reads its input in blocks. parse_ini and parse_ini_ex
+ * read from a FILE stream, parse_ini_reader takes any function that
+ * can fill a buffer: a decompressor, a socket, a block of memory.
+ *
+ * in/out: handle, whatever the reader needs to find its input
+ * out   : buffer to fill
+ * in    : size of the buffer
+ * return: bytes placed in the buffer, 0 at end of input, or
+ *         negative on an error
+ *
+ * the parser reads ahead. after a parse that stops early the
+ * underlying input is positioned some way past the last pair
+ * delivered.
+ */
+
+typedef
+long
+(*fn_reader)(
+	void *handle,
+	char *buffer,
+	size_t buflen
+);
+
+/*
+ * parse_ini_reader
+ *
+ * parse_ini_ex over a reader function instead of a FILE stream.
+ */
+
+int
+parse_ini_reader(
+	fn_reader reader,
+	void *handle,
+	void *userdata,
+	fn_callback callback,
+	const ini_options *options
+);
+
+#endif /* INIPARSER_H */
+
 /* iniparser.h ends here */
@@ -0,0 +1,509 @@
+/* inischema.c -- validate ini pairs against a schema while parsing */
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+#include "inischema.h"
+
+/*
+ * the schema is an ini_table of sections, each with an ini_table of
+ * keys. every key also gets a number, its place in the whole schema,
+ * and every section a number among the sections. a validator keeps
+ * its 'seen' flags in flat arrays indexed by those numbers, so one
+ * schema can serve any number of parses, even at the same time.
+ */
+
+typedef struct skey {
+	ini_named n;
+	size_t number;
+	int type;
+	int flags;
+	double min;
+	double max;
+	char *default_value;
+} skey;
+
+typedef struct ssec {
+	ini_named n;
+	size_t number;
+	bool allow_unknown_keys;
+	ini_table keys;
+} ssec;
+
+struct ini_schema {
+	bool allow_unknown_sections;
+	ini_table sections;
+	size_t key_count;
+};
+
+typedef struct section_state {
+	bool seen;
+	long line;           /* of its first header */
+	long column;
+} section_state;
+
+struct ini_validator {
+	const ini_schema *schema;
+	fn_schema_error on_error;
+	void *userdata;
+	fn_callback deliver;
+	void *deliver_ctx;
+	bool failed;
+	bool in_section;     /* a section is open, even an unknown one */
+	const ssec *current; /* NULL if not in the schema              */
+	bool *key_seen;
+	section_state *sections;
+};
+
+static
+char *
+copy_string(
+	const char *s
+) {
+	size_t len = strlen(s) + 1;
+	char *p = malloc(len);
+	if (p != NULL)
+		memcpy(p, s, len);
+	return p;
+}
+
+static
+uint64_t
+name_hash(
+	const char *name
+) {
+	return ini_hash_bytes(name, strlen(name), INI_HASH_SEED);
+}
+
+ini_schema *
+ini_schema_create(
+	bool allow_unknown_sections
+) {
+	ini_schema *schema = calloc(1, sizeof(ini_schema));
+	if (schema != NULL)
+		schema->allow_unknown_sections = allow_unknown_sections;
+	return schema;
+}
+
+void
+ini_schema_free(
+	ini_schema *schema
+) {
+	if (schema == NULL)
+		return;
+	for (size_t i = 0; i < schema->sections.count; i++) {
+		ssec *s = (ssec *)schema->sections.order[i];
+		for (size_t j = 0; j < s->keys.count; j++) {
+			skey *k = (skey *)s->keys.order[j];
+			free(k->n.name);
+			free(k->default_value);
+			free(k);
+		}
+		ini_table_free(&s->keys);
+		free(s->n.name);
+		free(s);
+	}
+	ini_table_free(&schema->sections);
+	free(schema);
+}
+
+/*
+ * find_or_add_section
+ *
+ * the section's record, created if needed.
+ */
+
+static
+ssec *
+find_or_add_section(
+	ini_schema *schema,
+	const char *section
+) {
+	uint64_t hash = name_hash(section);
+	ssec *s = (ssec *)ini_table_find(&schema->sections, section, hash);
+	if (s != NULL)
+		return s;
+	s = calloc(1, sizeof(ssec));
+	if (s == NULL)
+		return NULL;
+	s->n.name = copy_string(section);
+	s->n.hash = hash;
+	s->number = schema->sections.count;
+	if (s->n.name == NULL || !ini_table_add(&schema->sections, &s->n)) {
+		free(s->n.name);
+		free(s);
+		return NULL;
+	}
+	return s;
+}
+
+bool
+ini_schema_section(
+	ini_schema *schema,
+	const char *section,
+	bool allow_unknown_keys
+) {
+	ssec *s = find_or_add_section(schema, section);
+	if (s == NULL)
+		return false;
+	s->allow_unknown_keys = allow_unknown_keys;
+	return true;
+}
+
+bool
+ini_schema_key(
+	ini_schema *schema,
+	const char *section,
+	const char *key,
+	int type,
+	int flags,
+	double min,
+	double max,
+	const char *default_value
+) {
+	ssec *s = find_or_add_section(schema, section);
+	if (s == NULL)
+		return false;
+	uint64_t hash = name_hash(key);
+	if (ini_table_find(&s->keys, key, hash) != NULL)
+		return false;
+
+	skey *k = calloc(1, sizeof(skey));
+	if (k == NULL)
+		return false;
+	k->n.name = copy_string(key);
+	k->n.hash = hash;
+	k->number = schema->key_count;
+	k->type = type;
+	k->flags = flags;
+	k->min = min;
+	k->max = max;
+	if (default_value != NULL)
+		k->default_value = copy_string(default_value);
+	if (k->n.name == NULL || (default_value != NULL && k->default_value == NULL)
+		|| !ini_table_add(&s->keys, &k->n)) {
+		free(k->n.name);
+		free(k->default_value);
+		free(k);
+		return false;
+	}
+	schema->key_count += 1;
+	return true;
+}
+
+/*
+ * the conversions. each must consume the whole value.
+ */
+
+bool
+ini_schema_int(
+	const char *value,
+	long long *result
+) {
+	/* base 10, leading zeros and all, unless there's a 0x. */
+
+	const char *digits = value[0] == '+' || value[0] == '-' ? value + 1 : value;
+	int base = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')
+		? 16 : 10;
+	char *end;
+	errno = 0;
+	long long n = strtoll(value, &end, base);
+	if (end == value || *end != '\0' || errno == ERANGE)
+		return false;
+	*result = n;
+	return true;
+}
+
+bool
+ini_schema_float(
+	const char *value,
+	double *result
+) {
+	char *end;
+	errno = 0;
+	double d = strtod(value, &end);
+	if (end == value || *end != '\0' || errno == ERANGE || !isfinite(d))
+		return false;
+	*result = d;
+	return true;
+}
+
+/*
+ * same_word
+ *
+ * a case blind compare against a lower case word.
+ */
+
+static
+bool
+same_word(
+	const char *value,
+	const char *word
+) {
+	while (*value && tolower((unsigned char)*value) == *word) {
+		value += 1;
+		word += 1;
+	}
+	return *value == '\0' && *word == '\0';
+}
+
+bool
+ini_schema_bool(
+	const char *value,
+	bool *result
+) {
+	static const char *yes[] = { "true", "yes", "on", "1", NULL };
+	static const char *no[] = { "false", "no", "off", "0", NULL };
+	for (int i = 0; yes[i] != NULL; i++) {
+		if (same_word(value, yes[i])) {
+			*result = true;
+			return true;
+		}
+		if (same_word(value, no[i])) {
+			*result = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+ini_validator *
+ini_validator_create(
+	const ini_schema *schema,
+	fn_schema_error on_error,
+	void *userdata,
+	fn_callback deliver,
+	void *deliver_ctx
+) {
+	ini_validator *v = calloc(1, sizeof(ini_validator));
+	if (v == NULL)
+		return NULL;
+	v->schema = schema;
+	v->on_error = on_error;
+	v->userdata = userdata;
+	v->deliver = deliver;
+	v->deliver_ctx = deliver_ctx;
+	v->key_seen = calloc(schema->key_count + 1, sizeof(bool));
+	v->sections = calloc(schema->sections.count + 1, sizeof(section_state));
+	if (v->key_seen == NULL || v->sections == NULL) {
+		ini_validator_free(v);
+		return NULL;
+	}
+	return v;
+}
+
+void
+ini_validator_free(
+	ini_validator *v
+) {
+	if (v == NULL)
+		return;
+	free(v->key_seen);
+	free(v->sections);
+	free(v);
+}
+
+bool
+ini_validator_failed(
+	const ini_validator *v
+) {
+	return v->failed;
+}
+
+/*
+ * report
+ *
+ * a problem was found. pass it to the client and remember that the
+ * parse has failed.
+ */
+
+static
+void
+report(
+	ini_validator *v,
+	long line,
+	long column,
+	const char *section,
+	const char *key,
+	const char *message
+) {
+	v->failed = true;
+	if (v->on_error != NULL)
+		v->on_error(line, column, section, key, message, v->userdata);
+}
+
+/*
+ * fill_defaults
+ *
+ * deliver the defaults of a section's unseen keys.
+ *
+ * return: true if deliver asked for a stop
+ */
+
+static
+bool
+fill_defaults(
+	ini_validator *v,
+	const ssec *s
+) {
+	for (size_t i = 0; i < s->keys.count; i++) {
+		const skey *k = (const skey *)s->keys.order[i];
+		if (k->default_value == NULL || v->key_seen[k->number])
+			continue;
+		v->key_seen[k->number] = true;
+		if (v->deliver(s->n.name, k->n.name, k->default_value, v->deliver_ctx))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * open_section
+ *
+ * make 'section' current. defaults wait for the end of the parse,
+ * a section that appears again later may still set the key.
+ */
+
+static
+bool
+open_section(
+	ini_validator *v,
+	const char *section,
+	long line,
+	long column
+) {
+	v->in_section = true;
+	v->current = (const ssec *)ini_table_find(&v->schema->sections,
+			section, name_hash(section));
+
+	if (v->current == NULL) {
+		if (!v->schema->allow_unknown_sections)
+			report(v, line, column, section, NULL, "unknown section");
+		return false;
+	}
+
+	section_state *st = &v->sections[v->current->number];
+	if (!st->seen) {
+		st->seen = true;
+		st->line = line;
+		st->column = column;
+	}
+	return false;
+}
+
+bool
+ini_validator_section(
+	ini_validator *v,
+	const char *section,
+	long line,
+	long column
+) {
+	return open_section(v, section, line, column);
+}
+
+bool
+ini_validator_pair(
+	ini_validator *v,
+	const char *key,
+	const char *value,
+	long line,
+	long key_column,
+	long value_column
+) {
+	/* pairs ahead of the first header belong to section "". */
+
+	if (!v->in_section)
+		open_section(v, "", line, key_column);
+
+	/* an unknown section was reported at its header. if it isn't
+	 * allowed its pairs are withheld, like unknown keys. */
+
+	const ssec *s = v->current;
+	if (s == NULL)
+		return v->schema->allow_unknown_sections;
+
+	const skey *k = (const skey *)ini_table_find(&s->keys, key,
+			name_hash(key));
+	if (k == NULL) {
+		if (s->allow_unknown_keys)
+			return true;
+		report(v, line, key_column, s->n.name, key, "unknown key");
+		return false;
+	}
+	v->key_seen[k->number] = true;
+
+	double number = 0;
+	long long integer = 0;
+	bool flag;
+	const char *problem = NULL;
+	switch (k->type) {
+	case INI_TYPE_INT:
+		if (!ini_schema_int(value, &integer))
+			problem = "not an integer";
+		number = integer;
+		break;
+	case INI_TYPE_FLOAT:
+		if (!ini_schema_float(value, &number))
+			problem = "not a number";
+		break;
+	case INI_TYPE_BOOL:
+		if (!ini_schema_bool(value, &flag))
+			problem = "not a boolean";
+		break;
+	default:
+		number = strlen(value);
+		break;
+	}
+
+	if (problem == NULL && (k->flags & INI_KEY_RANGE)
+		&& k->type != INI_TYPE_BOOL && (number < k->min || number > k->max))
+		problem = k->type == INI_TYPE_STRING
+			? "length out of range" : "out of range";
+
+	if (problem != NULL) {
+		report(v, line, value_column, s->n.name, key, problem);
+		return false;
+	}
+	return true;
+}
+
+bool
+ini_validator_finish(
+	ini_validator *v,
+	long line
+) {
+	v->current = NULL;
+
+	/* every section gets the defaults of its unseen keys now, and
+	 * any required key still unseen is reported. a missing key
+	 * is reported at its section's header, or at end of file if
+	 * the section never appeared. */
+
+	const ini_table *sections = &v->schema->sections;
+	for (size_t i = 0; i < sections->count; i++) {
+		const ssec *s = (const ssec *)sections->order[i];
+		const section_state *st = &v->sections[s->number];
+		if (fill_defaults(v, s))
+			return true;
+		for (size_t j = 0; j < s->keys.count; j++) {
+			const skey *k = (const skey *)s->keys.order[j];
+			if (!(k->flags & INI_KEY_REQUIRED) || v->key_seen[k->number])
+				continue;
+			if (st->seen)
+				report(v, st->line, st->column, s->n.name, k->n.name,
+					"required key missing");
+			else
+				report(v, line, 1, s->n.name, k->n.name,
+					"required key missing, section not found");
+		}
+	}
+	return false;
+}
+
+/* inischema.c ends here */
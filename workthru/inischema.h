@@ -0,0 +1,204 @@
+/* inischema.h -- validate ini pairs against a schema while parsing */
+
+#ifndef INISCHEMA_H
+#define INISCHEMA_H
+
+#include <stdbool.h>
+
+#include "iniparser.h"
+
+/*
+ * a schema lists the sections and keys a file may hold, the type
+ * of each key's value, and optional limits and defaults. hand it to
+ * the parser in ini_options.schema and each pair is checked as it
+ * is read, so there is no second pass over the results.
+ *
+ * - a pair whose value fails its check is reported and not passed
+ *   to the callback, nor is an unknown key or a pair in an unknown
+ *   section, unless they are allowed.
+ * - at end of file, keys with a default that were not seen in any
+ *   appearance of their section are passed to the callback with
+ *   their default value, declared sections that never appeared
+ *   included, in schema order after the last pair of the file.
+ * - at end of file, required keys that were never seen are
+ *   reported.
+ *
+ * every problem is reported to ini_options.schema_error, if set,
+ * with a line and column, and the parse carries on so that one pass
+ * finds them all. the parse then returns EXIT_FAILURE.
+ *
+ * types:
+ *
+ *   INI_TYPE_STRING - anything
+ *   INI_TYPE_INT    - a base 10 integer, 0x hex also accepted
+ *   INI_TYPE_FLOAT  - anything strtod takes in full, but not nan
+ *                     or inf
+ *   INI_TYPE_BOOL   - true false yes no on off 1 0, any case
+ *
+ * flags:
+ *
+ *   INI_KEY_REQUIRED - must appear somewhere in the file
+ *   INI_KEY_RANGE    - min <= value <= max for numbers, and
+ *                      min <= length <= max for strings
+ */
+
+#define INI_TYPE_STRING 0
+#define INI_TYPE_INT    1
+#define INI_TYPE_FLOAT  2
+#define INI_TYPE_BOOL   3
+
+#define INI_KEY_REQUIRED 0x01
+#define INI_KEY_RANGE    0x02
+
+typedef struct ini_schema ini_schema;
+
+/*
+ * ini_schema_create
+ *
+ * in    : may the file hold sections the schema doesn't declare
+ * return: an empty schema or NULL if memory is exhausted
+ */
+
+ini_schema *
+ini_schema_create(
+	bool allow_unknown_sections
+);
+
+void
+ini_schema_free(
+	ini_schema *schema
+);
+
+/*
+ * ini_schema_section
+ *
+ * declare a section. declaring a key declares its section, this is
+ * only needed to allow unknown keys or for a section without keys.
+ *
+ * in/out: the schema
+ * in    : section name, "" for pairs ahead of any [section]
+ * in    : may the section hold keys the schema doesn't declare
+ * return: false if memory is exhausted
+ */
+
+bool
+ini_schema_section(
+	ini_schema *schema,
+	const char *section,
+	bool allow_unknown_keys
+);
+
+/*
+ * ini_schema_key
+ *
+ * declare a key.
+ *
+ * in/out: the schema
+ * in    : section and key names
+ * in    : INI_TYPE of the value
+ * in    : INI_KEY flags
+ * in    : limits, used if INI_KEY_RANGE is set
+ * in    : default value or NULL for none
+ * return: false if memory is exhausted or the key is already
+ *         declared
+ */
+
+bool
+ini_schema_key(
+	ini_schema *schema,
+	const char *section,
+	const char *key,
+	int type,
+	int flags,
+	double min,
+	double max,
+	const char *default_value
+);
+
+/*
+ * the conversions the schema checks with, so a client can turn a
+ * validated value into its type.
+ *
+ * return: false if the text is not a valid value of the type
+ */
+
+bool
+ini_schema_int(
+	const char *value,
+	long long *result
+);
+
+bool
+ini_schema_float(
+	const char *value,
+	double *result
+);
+
+bool
+ini_schema_bool(
+	const char *value,
+	bool *result
+);
+
+/*
+ * the parser's side. clients don't call these, the parser does when
+ * ini_options.schema is set.
+ *
+ * ini_validator_section: a [section] header was read.
+ * ini_validator_pair   : a pair was read, false if it fails.
+ * ini_validator_finish : end of file.
+ *
+ * defaults are passed to 'deliver' with 'deliver_ctx'. section and
+ * finish return true if deliver asked for a stop.
+ */
+
+typedef struct ini_validator ini_validator;
+
+ini_validator *
+ini_validator_create(
+	const ini_schema *schema,
+	fn_schema_error on_error,
+	void *userdata,
+	fn_callback deliver,
+	void *deliver_ctx
+);
+
+void
+ini_validator_free(
+	ini_validator *v
+);
+
+bool
+ini_validator_section(
+	ini_validator *v,
+	const char *section,
+	long line,
+	long column
+);
+
+bool
+ini_validator_pair(
+	ini_validator *v,
+	const char *key,
+	const char *value,
+	long line,
+	long key_column,
+	long value_column
+);
+
+bool
+ini_validator_finish(
+	ini_validator *v,
+	long line
+);
+
+/* were any problems found. */
+
+bool
+ini_validator_failed(
+	const ini_validator *v
+);
+
+#endif /* INISCHEMA_H */
+
+/* inischema.h ends here */
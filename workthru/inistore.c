@@ -0,0 +1,477 @@
+/* inistore.c -- a compact read only store of the pairs of an ini file */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+#include "inistore.h"
+
+/*
+ * a slot holds a string of up to seven bytes, its unused bytes
+ * zeroed, with 7 - length in the last byte. a seven byte string's
+ * last byte is then 0, so every inline string is terminated where
+ * it sits and can be handed out as it is. a longer string has its
+ * pool offset in the first four bytes and POOLED in the last.
+ *
+ * while the store is built, pooled strings are interned through an
+ * open addressed table of pool offsets with a 32 bit piece of each
+ * string's hash beside it, so most mismatches are ruled out without
+ * touching the pool. finish drops that table, a finished store
+ * never adds strings.
+ *
+ * the lookup table is built by finish. it is open addressed and
+ * holds 1 + the number of the last pair for each section:key. it
+ * never changes once built, so it is allowed to run three quarters
+ * full instead of the half that the growing tables elsewhere keep.
+ */
+
+#define POOLED     0xff
+#define INLINE_MAX 7
+
+typedef struct slot {
+	unsigned char b[8];
+} slot;
+
+typedef struct spair {
+	slot key;
+	slot value;
+} spair;
+
+typedef struct srun {
+	slot name;
+	uint32_t first;      /* first pair under this header */
+} srun;
+
+struct ini_store {
+	spair *pairs;
+	size_t count;
+	size_t capacity;
+	srun *runs;
+	size_t run_count;
+	size_t run_capacity;
+	char *pool;
+	size_t pool_len;
+	size_t pool_capacity;
+	uint32_t *intern;    /* 1 + pool offset, 0 empty     */
+	uint32_t *intern_hash;
+	size_t intern_size;  /* a power of two               */
+	size_t pooled;
+	uint32_t *lookup;    /* 1 + pair number, 0 empty     */
+	size_t lookup_size;  /* a power of two               */
+	size_t strings;
+	size_t inlined;
+	size_t text_bytes;
+	bool failed;         /* an add failed, finish says so */
+	bool finished;
+};
+
+static
+const char *
+text_of(
+	const ini_store *store,
+	const slot *s
+) {
+	if (s->b[INLINE_MAX] != POOLED)
+		return (const char *)s->b;
+	uint32_t offset;
+	memcpy(&offset, s->b, sizeof(offset));
+	return store->pool + offset;
+}
+
+/*
+ * grow
+ *
+ * make room for one more element in an array that doubles.
+ */
+
+static
+bool
+grow(
+	void **array,
+	size_t *capacity,
+	size_t count,
+	size_t size
+) {
+	if (count < *capacity)
+		return true;
+	size_t bigger = *capacity ? *capacity * 2 : 64;
+	void *p = realloc(*array, bigger * size);
+	if (p == NULL)
+		return false;
+	*array = p;
+	*capacity = bigger;
+	return true;
+}
+
+/*
+ * intern
+ *
+ * the pool offset of a string, adding it if it isn't there.
+ *
+ * return: false if memory or the 32 bit pool is exhausted
+ */
+
+static
+bool
+intern(
+	ini_store *store,
+	const char *s,
+	size_t len,
+	uint32_t *offset
+) {
+	if ((store->pooled + 1) * 2 > store->intern_size) {
+		size_t bigger = store->intern_size ? store->intern_size * 2 : 1024;
+		uint32_t *table = calloc(bigger, sizeof(uint32_t));
+		uint32_t *hashes = malloc(bigger * sizeof(uint32_t));
+		if (table == NULL || hashes == NULL) {
+			free(table);
+			free(hashes);
+			return false;
+		}
+		for (size_t i = 0; i < store->intern_size; i++) {
+			if (store->intern[i] == 0)
+				continue;
+			size_t j = store->intern_hash[i] & (bigger - 1);
+			while (table[j] != 0)
+				j = (j + 1) & (bigger - 1);
+			table[j] = store->intern[i];
+			hashes[j] = store->intern_hash[i];
+		}
+		free(store->intern);
+		free(store->intern_hash);
+		store->intern = table;
+		store->intern_hash = hashes;
+		store->intern_size = bigger;
+	}
+
+	uint32_t hash = (uint32_t)ini_hash_fast(s, len, 0);
+	size_t mask = store->intern_size - 1;
+	size_t j = hash & mask;
+	while (store->intern[j] != 0) {
+		if (store->intern_hash[j] == hash
+			&& strcmp(store->pool + store->intern[j] - 1, s) == 0) {
+			*offset = store->intern[j] - 1;
+			return true;
+		}
+		j = (j + 1) & mask;
+	}
+
+	if (store->pool_len + len + 2 > UINT32_MAX)
+		return false;
+	while (store->pool_len + len + 1 > store->pool_capacity) {
+		size_t bigger = store->pool_capacity ? store->pool_capacity * 2 : 65536;
+		char *pool = realloc(store->pool, bigger);
+		if (pool == NULL)
+			return false;
+		store->pool = pool;
+		store->pool_capacity = bigger;
+	}
+	*offset = store->pool_len;
+	memcpy(store->pool + store->pool_len, s, len + 1);
+	store->pool_len += len + 1;
+	store->intern[j] = *offset + 1;
+	store->intern_hash[j] = hash;
+	store->pooled += 1;
+	return true;
+}
+
+/*
+ * fill_slot
+ *
+ * put a string in a slot, inline if it fits.
+ */
+
+static
+bool
+fill_slot(
+	ini_store *store,
+	const char *s,
+	slot *out
+) {
+	size_t len = strlen(s);
+	store->strings += 1;
+	memset(out->b, 0, sizeof(out->b));
+	if (len <= INLINE_MAX) {
+		memcpy(out->b, s, len);
+		out->b[INLINE_MAX] = INLINE_MAX - len;
+		store->inlined += 1;
+		return true;
+	}
+	uint32_t offset;
+	if (!intern(store, s, len, &offset))
+		return false;
+	memcpy(out->b, &offset, sizeof(offset));
+	out->b[INLINE_MAX] = POOLED;
+	return true;
+}
+
+ini_store *
+ini_store_create(void) {
+	return calloc(1, sizeof(ini_store));
+}
+
+/*
+ * ini_store_add
+ *
+ * a pair under a different section than the one before it starts
+ * a new run.
+ */
+
+bool
+ini_store_add(
+	ini_store *store,
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	if (store->failed || store->finished)
+		return false;
+	store->failed = true;
+	if (store->count >= UINT32_MAX - 1)
+		return false;
+
+	if (store->run_count == 0
+		|| strcmp(text_of(store, &store->runs[store->run_count - 1].name),
+			section) != 0) {
+		if (!grow((void **)&store->runs, &store->run_capacity,
+				store->run_count, sizeof(srun)))
+			return false;
+		srun *r = &store->runs[store->run_count];
+		if (!fill_slot(store, section, &r->name))
+			return false;
+		r->first = store->count;
+		store->run_count += 1;
+	}
+
+	if (!grow((void **)&store->pairs, &store->capacity, store->count,
+			sizeof(spair)))
+		return false;
+	spair *p = &store->pairs[store->count];
+	if (!fill_slot(store, key, &p->key) || !fill_slot(store, value, &p->value))
+		return false;
+	store->count += 1;
+	store->text_bytes += strlen(section) + strlen(key) + strlen(value) + 3;
+	store->failed = false;
+	return true;
+}
+
+bool
+ini_store_callback(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+) {
+	return !ini_store_add(user_data, section, key, value);
+}
+
+/*
+ * run_of
+ *
+ * the run holding pair i, a binary search on the runs' first pairs.
+ */
+
+static
+const srun *
+run_of(
+	const ini_store *store,
+	size_t i
+) {
+	size_t lo = 0;
+	size_t hi = store->run_count;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (store->runs[mid].first <= i)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return &store->runs[lo];
+}
+
+static
+uint64_t
+hash_pair(
+	const char *section,
+	const char *key
+) {
+	return ini_hash_fast(key, strlen(key),
+		ini_hash_fast(section, strlen(section), 0));
+}
+
+/*
+ * shrink
+ *
+ * give back the unused end of an array.
+ */
+
+static
+void
+shrink(
+	void **array,
+	size_t *capacity,
+	size_t count,
+	size_t size
+) {
+	if (count == 0 || count == *capacity)
+		return;
+	void *p = realloc(*array, count * size);
+	if (p != NULL) {
+		*array = p;
+		*capacity = count;
+	}
+}
+
+bool
+ini_store_finish(
+	ini_store *store
+) {
+	if (store->failed)
+		return false;
+	if (store->finished)
+		return true;
+
+	shrink((void **)&store->pairs, &store->capacity, store->count, sizeof(spair));
+	shrink((void **)&store->runs, &store->run_capacity, store->run_count,
+		sizeof(srun));
+	shrink((void **)&store->pool, &store->pool_capacity, store->pool_len, 1);
+	free(store->intern);
+	free(store->intern_hash);
+	store->intern = NULL;
+	store->intern_hash = NULL;
+	store->intern_size = 0;
+
+	size_t size = 16;
+	while (size * 3 < store->count * 4)
+		size *= 2;
+	store->lookup = calloc(size, sizeof(uint32_t));
+	if (store->lookup == NULL) {
+		store->failed = true;
+		return false;
+	}
+	store->lookup_size = size;
+
+	/* walk the runs and their pairs together. a later pair with
+	 * the same section and key takes over the slot. */
+
+	size_t r = 0;
+	for (size_t i = 0; i < store->count; i++) {
+		while (r + 1 < store->run_count && store->runs[r + 1].first <= i)
+			r += 1;
+		const char *section = text_of(store, &store->runs[r].name);
+		const char *key = text_of(store, &store->pairs[i].key);
+		size_t j = hash_pair(section, key) & (size - 1);
+		while (store->lookup[j] != 0) {
+			size_t p = store->lookup[j] - 1;
+			if (strcmp(text_of(store, &store->pairs[p].key), key) == 0
+				&& strcmp(text_of(store, &run_of(store, p)->name), section) == 0)
+				break;
+			j = (j + 1) & (size - 1);
+		}
+		store->lookup[j] = i + 1;
+	}
+	store->finished = true;
+	return true;
+}
+
+ini_store *
+ini_store_build(
+	FILE *ini_file
+) {
+	ini_store *store = ini_store_create();
+	if (store == NULL)
+		return NULL;
+	int status = parse_ini(ini_file, store, ini_store_callback);
+	if (status != EXIT_SUCCESS || !ini_store_finish(store)) {
+		ini_store_free(store);
+		return NULL;
+	}
+	return store;
+}
+
+void
+ini_store_free(
+	ini_store *store
+) {
+	if (store == NULL)
+		return;
+	free(store->pairs);
+	free(store->runs);
+	free(store->pool);
+	free(store->intern);
+	free(store->intern_hash);
+	free(store->lookup);
+	free(store);
+}
+
+const char *
+ini_store_get(
+	const ini_store *store,
+	const char *section,
+	const char *key
+) {
+	if (!store->finished || store->count == 0)
+		return NULL;
+	size_t mask = store->lookup_size - 1;
+	size_t j = hash_pair(section, key) & mask;
+	while (store->lookup[j] != 0) {
+		size_t p = store->lookup[j] - 1;
+		if (strcmp(text_of(store, &store->pairs[p].key), key) == 0
+			&& strcmp(text_of(store, &run_of(store, p)->name), section) == 0)
+			return text_of(store, &store->pairs[p].value);
+		j = (j + 1) & mask;
+	}
+	return NULL;
+}
+
+size_t
+ini_store_count(
+	const ini_store *store
+) {
+	return store->count;
+}
+
+bool
+ini_store_pair(
+	const ini_store *store,
+	size_t i,
+	const char **section,
+	const char **key,
+	const char **value
+) {
+	if (i >= store->count)
+		return false;
+	*section = text_of(store, &run_of(store, i)->name);
+	*key = text_of(store, &store->pairs[i].key);
+	*value = text_of(store, &store->pairs[i].value);
+	return true;
+}
+
+void
+ini_store_footprint(
+	const ini_store *store,
+	ini_footprint *fp
+) {
+	memset(fp, 0, sizeof(ini_footprint));
+	fp->pairs = store->count;
+	fp->sections = store->run_count;
+	fp->strings = store->strings;
+	fp->inlined = store->inlined;
+	fp->pooled = store->pooled;
+	fp->text_bytes = store->text_bytes;
+	fp->pool_bytes = store->pool_capacity;
+	fp->record_bytes = store->capacity * sizeof(spair)
+		+ store->run_capacity * sizeof(srun);
+	fp->index_bytes = store->lookup_size * sizeof(uint32_t)
+		+ store->intern_size * 2 * sizeof(uint32_t);
+	fp->total_bytes = sizeof(ini_store) + fp->pool_bytes + fp->record_bytes
+		+ fp->index_bytes;
+	fp->bytes_per_pair = fp->pairs ? (double)fp->total_bytes / fp->pairs : 0;
+	fp->dedup_ratio = fp->pooled
+		? (double)(fp->strings - fp->inlined) / fp->pooled : 1.0;
+}
+
+/* inistore.c ends here */
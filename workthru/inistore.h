@@ -0,0 +1,192 @@
+/* inistore.h -- a compact read only store of the pairs of an ini file */
+
+#ifndef INISTORE_H
+#define INISTORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "iniparser.h"
+
+/*
+ * the store is for a configuration that is parsed once and then
+ * kept for the life of the process. it holds the same pairs as an
+ * ini_index in a fraction of the memory, but only answers lookups
+ * by section and key and walks in file order.
+ *
+ * - every string, section, key, or value, is an eight byte slot. a
+ *   string of up to seven bytes lives in its slot. a longer one is
+ *   a 32 bit offset into a pool of strings.
+ * - strings in the pool are interned, each distinct string is
+ *   stored once however often it appears. 'true', '0', and the same
+ *   host name on a thousand lines cost one copy.
+ * - a pair is two slots, key and value, sixteen bytes. a run of
+ *   pairs under one section header shares a single section slot.
+ * - lookups go through an open addressed table of 32 bit pair
+ *   numbers, up to three quarters full.
+ *
+ * the pool and the counts are limited to 32 bits, a store can not
+ * hold more than about 4G of distinct strings or 4G pairs.
+ *
+ * strings returned by the store are terminated and live as long as
+ * the store.
+ */
+
+typedef struct ini_store ini_store;
+
+/*
+ * footprint
+ *
+ * what the store holds and what it costs, for sizing hosts.
+ *
+ * pairs       : pairs added.
+ * sections    : runs of pairs under one header. a section whose
+ *               header appears twice counts twice.
+ * strings     : section, key, and value strings referenced, one
+ *               section per run.
+ * inlined     : of those, short enough to live in their slot.
+ * pooled      : distinct strings in the pool.
+ * text_bytes  : what a copy of every string would take, terminators
+ *               included, with one section name per pair.
+ * pool_bytes  : bytes of the string pool.
+ * record_bytes: the pair and section arrays.
+ * index_bytes : the lookup table.
+ * total_bytes : everything the store has allocated.
+ *
+ * bytes_per_pair: total_bytes / pairs.
+ * dedup_ratio   : references to pooled strings per pooled string.
+ *                 1.0 means nothing repeated.
+ */
+
+typedef struct ini_footprint {
+	size_t pairs;
+	size_t sections;
+	size_t strings;
+	size_t inlined;
+	size_t pooled;
+	size_t text_bytes;
+	size_t pool_bytes;
+	size_t record_bytes;
+	size_t index_bytes;
+	size_t total_bytes;
+	double bytes_per_pair;
+	double dedup_ratio;
+} ini_footprint;
+
+/*
+ * ini_store_create
+ *
+ * create an empty store. pairs are added with ini_store_add, or by
+ * passing ini_store_callback and the store to parse_ini. the store
+ * can not be queried until ini_store_finish is called.
+ *
+ * return: a new store or NULL if memory is exhausted
+ */
+
+ini_store *
+ini_store_create(void);
+
+/*
+ * ini_store_add
+ *
+ * add a section:key:value triple to an unfinished store.
+ *
+ * return: false if memory or the 32 bit limits are exhausted
+ */
+
+bool
+ini_store_add(
+	ini_store *store,
+	const char *section,
+	const char *key,
+	const char *value
+);
+
+/* an fn_callback that adds each pair to the store in user_data. */
+
+bool
+ini_store_callback(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+);
+
+/*
+ * ini_store_finish
+ *
+ * trim the arrays to size, drop the intern table, and build the
+ * lookup table. after this the store is read only.
+ *
+ * return: false if an earlier add failed or memory is exhausted
+ */
+
+bool
+ini_store_finish(
+	ini_store *store
+);
+
+/* convenience: parse a stream into a new finished store, or NULL. */
+
+ini_store *
+ini_store_build(
+	FILE *ini_file
+);
+
+void
+ini_store_free(
+	ini_store *store
+);
+
+/*
+ * ini_store_get
+ *
+ * the value of section:key. if the key was repeated, the last
+ * occurrence in the file.
+ *
+ * return: the value or NULL if not found
+ */
+
+const char *
+ini_store_get(
+	const ini_store *store,
+	const char *section,
+	const char *key
+);
+
+/* pairs in the store. */
+
+size_t
+ini_store_count(
+	const ini_store *store
+);
+
+/*
+ * ini_store_pair
+ *
+ * the i'th pair in file order, for walking the store.
+ *
+ * out   : section, key, and value
+ * return: false if i is past the end
+ */
+
+bool
+ini_store_pair(
+	const ini_store *store,
+	size_t i,
+	const char **section,
+	const char **key,
+	const char **value
+);
+
+void
+ini_store_footprint(
+	const ini_store *store,
+	ini_footprint *fp
+);
+
+#endif /* INISTORE_H */
+
+/* inistore.h ends here */
@@ -0,0 +1,1004 @@
+/* iniversion.c -- immutable config versions that share unchanged sections */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+#include "iniversion.h"
+
+/*
+ * the trie
+ *
+ * a node has a bit for each of its 32 slots that is in use and a
+ * second bit set for each used slot that holds a section instead of
+ * another node. only used slots are stored, in bit order, so a
+ * slot's place in 'child' is the count of used bits below it.
+ *
+ * a section's slot at depth d is five bits of the hash of its name.
+ * twelve levels use the 60 low bits of the stored hash, deeper
+ * levels, which two names only reach if those 60 bits are the same,
+ * hash the name again with the level as seed.
+ *
+ * nodes and sections are reference counted and never change once
+ * a version can see them. a derive copies each node on the path to
+ * a changed section unless it already holds the only reference to
+ * it, which means the node is a copy it made itself, and then
+ * changes it in place.
+ */
+
+typedef struct vnode {
+	size_t refs;
+	uint32_t used;
+	uint32_t leaves;     /* used slots holding a section */
+	void *child[];
+} vnode;
+
+/*
+ * a section is one allocation: the struct, key and value pointers,
+ * the pair numbers sorted by key, the name, and the pair strings
+ * as "key\0value\0".
+ */
+
+struct ini_vsection {
+	size_t refs;
+	const char *name;
+	uint64_t hash;
+	size_t count;
+	const char **keys;
+	const char **values;
+	size_t *order;       /* by key, then file order      */
+	uint64_t met;        /* the last derive to read it   */
+};
+
+struct ini_version {
+	size_t refs;
+	vnode *root;
+	size_t sections;
+	size_t number;
+};
+
+#define LEVEL_BITS 5
+#define HASH_LEVELS 12
+
+static
+unsigned
+popcount(
+	uint32_t x
+) {
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	x = (x + (x >> 4)) & 0x0f0f0f0f;
+	return (x * 0x01010101) >> 24;
+}
+
+static
+uint64_t
+name_hash(
+	const char *name
+) {
+	return ini_hash_fast(name, strlen(name), 0);
+}
+
+/* the slot, 0 to 31, for a name at a depth. */
+
+static
+unsigned
+slot_at(
+	const char *name,
+	uint64_t hash,
+	int depth
+) {
+	int level = depth / HASH_LEVELS;
+	if (level > 0)
+		hash = ini_hash_fast(name, strlen(name), level);
+	return hash >> (LEVEL_BITS * (depth % HASH_LEVELS)) & 31;
+}
+
+static
+void
+section_release(
+	ini_vsection *s
+) {
+	if (s != NULL && --s->refs == 0)
+		free(s);
+}
+
+static
+vnode *
+node_new(
+	unsigned slots
+) {
+	vnode *n = malloc(sizeof(vnode) + slots * sizeof(void *));
+	if (n != NULL) {
+		n->refs = 1;
+		n->used = 0;
+		n->leaves = 0;
+	}
+	return n;
+}
+
+static
+void
+node_release(
+	vnode *n
+) {
+	if (n == NULL || --n->refs > 0)
+		return;
+	unsigned i = 0;
+	for (uint32_t m = n->used; m != 0; m &= m - 1, i++) {
+		if (n->leaves & (m & -m))
+			section_release(n->child[i]);
+		else
+			node_release(n->child[i]);
+	}
+	free(n);
+}
+
+/*
+ * own
+ *
+ * a node the caller may change. the caller holds one of its
+ * references, which passes to the copy if one is made.
+ *
+ * return: the node or its copy, NULL if memory is exhausted
+ */
+
+static
+vnode *
+own(
+	vnode *n
+) {
+	if (n->refs == 1)
+		return n;
+	unsigned count = popcount(n->used);
+	vnode *copy = node_new(count);
+	if (copy == NULL)
+		return NULL;
+	copy->used = n->used;
+	copy->leaves = n->leaves;
+	memcpy(copy->child, n->child, count * sizeof(void *));
+	unsigned i = 0;
+	for (uint32_t m = n->used; m != 0; m &= m - 1, i++) {
+		if (n->leaves & (m & -m))
+			((ini_vsection *)copy->child[i])->refs += 1;
+		else
+			((vnode *)copy->child[i])->refs += 1;
+	}
+	n->refs -= 1;
+	return copy;
+}
+
+/*
+ * insert
+ *
+ * put a section in the trie under *at, replacing one of the same
+ * name. the section's reference passes to the trie.
+ *
+ * in/out: the caller's reference to a node, or NULL for none
+ * return: false if memory is exhausted, *at is then unchanged
+ *         and the section still the caller's
+ */
+
+static
+bool
+insert(
+	vnode **at,
+	ini_vsection *s,
+	int depth
+) {
+	vnode *node = *at != NULL ? own(*at) : node_new(1);
+	if (node == NULL)
+		return false;
+	*at = node;
+
+	uint32_t bit = 1u << slot_at(s->name, s->hash, depth);
+	unsigned pos = popcount(node->used & (bit - 1));
+	unsigned count = popcount(node->used);
+
+	if (!(node->used & bit)) {
+		vnode *bigger = realloc(node, sizeof(vnode) + (count + 1) * sizeof(void *));
+		if (bigger == NULL)
+			return false;
+		node = *at = bigger;
+		memmove(&node->child[pos + 1], &node->child[pos],
+			(count - pos) * sizeof(void *));
+		node->child[pos] = s;
+		node->used |= bit;
+		node->leaves |= bit;
+		return true;
+	}
+
+	if (node->leaves & bit) {
+		ini_vsection *there = node->child[pos];
+		if (strcmp(there->name, s->name) == 0) {
+			section_release(there);
+			node->child[pos] = s;
+			return true;
+		}
+
+		/* two names share the slot, push both down a level. */
+
+		vnode *sub = NULL;
+		there->refs += 1;
+		if (!insert(&sub, there, depth + 1)) {
+			there->refs -= 1;
+			node_release(sub);
+			return false;
+		}
+		if (!insert(&sub, s, depth + 1)) {
+			node_release(sub);
+			return false;
+		}
+		section_release(there);
+		node->child[pos] = sub;
+		node->leaves &= ~bit;
+		return true;
+	}
+
+	vnode *child = node->child[pos];
+	bool ok = insert(&child, s, depth + 1);
+	node->child[pos] = child;
+	return ok;
+}
+
+/*
+ * remove_name
+ *
+ * take a section out of the trie under *at. a node left empty is
+ * released and *at becomes NULL.
+ *
+ * return: false if memory is exhausted
+ */
+
+static
+bool
+remove_name(
+	vnode **at,
+	const char *name,
+	uint64_t hash,
+	int depth
+) {
+	vnode *node = *at;
+	if (node == NULL)
+		return true;
+	uint32_t bit = 1u << slot_at(name, hash, depth);
+	if (!(node->used & bit))
+		return true;
+	node = own(node);
+	if (node == NULL)
+		return false;
+	*at = node;
+	unsigned pos = popcount(node->used & (bit - 1));
+	unsigned count = popcount(node->used);
+
+	if (node->leaves & bit) {
+		ini_vsection *there = node->child[pos];
+		if (strcmp(there->name, name) != 0)
+			return true;
+		section_release(there);
+	} else {
+		vnode *child = node->child[pos];
+		bool ok = remove_name(&child, name, hash, depth + 1);
+		node->child[pos] = child;
+		if (!ok)
+			return false;
+		if (child != NULL)
+			return true;
+	}
+
+	memmove(&node->child[pos], &node->child[pos + 1],
+		(count - pos - 1) * sizeof(void *));
+	node->used &= ~bit;
+	node->leaves &= ~bit;
+	if (node->used == 0) {
+		node_release(node);
+		*at = NULL;
+	}
+	return true;
+}
+
+static
+ini_vsection *
+lookup(
+	const vnode *node,
+	const char *name,
+	uint64_t hash
+) {
+	for (int depth = 0; node != NULL; depth++) {
+		uint32_t bit = 1u << slot_at(name, hash, depth);
+		if (!(node->used & bit))
+			return NULL;
+		void *child = node->child[popcount(node->used & (bit - 1))];
+		if (node->leaves & bit) {
+			ini_vsection *s = child;
+			return strcmp(s->name, name) == 0 ? s : NULL;
+		}
+		node = child;
+	}
+	return NULL;
+}
+
+static
+bool
+walk(
+	const vnode *node,
+	fn_vsection_visit visit,
+	void *user_data
+) {
+	if (node == NULL)
+		return false;
+	unsigned i = 0;
+	for (uint32_t m = node->used; m != 0; m &= m - 1, i++) {
+		bool stop = node->leaves & (m & -m)
+			? visit(node->child[i], user_data)
+			: walk(node->child[i], visit, user_data);
+		if (stop)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * the derive
+ *
+ * pairs are matched against the base's section as they arrive. a
+ * section is matched with a cursor, the old section and how many
+ * of its pairs came out the same so far, and nothing is allocated
+ * for it. only when a pair differs, or the section is new, or the
+ * cursor leaves a section before it has matched all of it, does the
+ * section get a builder. a builder copies the matched pairs from
+ * the old section and from then on collects pairs as
+ * "key\0value\0". a builder that isn't diverged yet goes on
+ * matching, for a section that comes back later in the file.
+ *
+ * each old section the derive meets is stamped with the serial
+ * number the caller gave the derive, so a section that comes back after matching in
+ * full is known as such, and sections the new file lacks are the
+ * ones without the stamp.
+ */
+
+typedef struct builder {
+	ini_named n;
+	const ini_vsection *old;
+	size_t matched;
+	bool diverged;
+	char *text;
+	size_t len;
+	size_t capacity;
+	size_t count;
+} builder;
+
+typedef struct derive {
+	ini_version *base;
+	uint64_t serial;
+	ini_table builders;
+	builder *current;           /* most recent builder        */
+	ini_vsection *cursor;       /* matching without a builder */
+	size_t matched;
+	size_t met;                 /* old sections stamped       */
+	bool failed;
+} derive;
+
+static
+bool
+append(
+	builder *b,
+	const char *key,
+	const char *value
+) {
+	size_t klen = strlen(key) + 1;
+	size_t vlen = strlen(value) + 1;
+	if (b->len + klen + vlen > b->capacity) {
+		size_t bigger = b->capacity ? b->capacity * 2 : 256;
+		while (bigger < b->len + klen + vlen)
+			bigger *= 2;
+		char *text = realloc(b->text, bigger);
+		if (text == NULL)
+			return false;
+		b->text = text;
+		b->capacity = bigger;
+	}
+	memcpy(b->text + b->len, key, klen);
+	memcpy(b->text + b->len + klen, value, vlen);
+	b->len += klen + vlen;
+	b->count += 1;
+	return true;
+}
+
+/* stop matching, copy what matched so far. */
+
+static
+bool
+diverge(
+	builder *b
+) {
+	b->diverged = true;
+	for (size_t i = 0; i < b->matched; i++) {
+		if (!append(b, b->old->keys[i], b->old->values[i]))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * new_builder
+ *
+ * a builder for a section, picking up 'matched' pairs into 'old'.
+ * a section that was in the base uses the base's copy of its name,
+ * the base outlives the derive.
+ *
+ * return: the builder or NULL if memory is exhausted
+ */
+
+static
+builder *
+new_builder(
+	derive *d,
+	const char *section,
+	const ini_vsection *old,
+	size_t matched
+) {
+	size_t len = strlen(section);
+	builder *b = calloc(1, sizeof(builder));
+	if (b == NULL)
+		return NULL;
+	b->old = old;
+	b->matched = matched;
+	if (old != NULL) {
+		b->n.name = (char *)old->name;
+	} else {
+		b->n.name = malloc(len + 1);
+		if (b->n.name != NULL)
+			memcpy(b->n.name, section, len + 1);
+	}
+	b->n.hash = ini_hash_bytes(section, len, INI_HASH_SEED);
+	if (b->n.name == NULL || !ini_table_add(&d->builders, &b->n)) {
+		if (old == NULL)
+			free(b->n.name);
+		free(b);
+		return NULL;
+	}
+	return d->current = b;
+}
+
+/*
+ * leave_cursor
+ *
+ * the cursor's section is done for now. if it matched only part of
+ * the old section it needs a builder, it is either cut short or
+ * comes back later.
+ *
+ * return: false if memory is exhausted
+ */
+
+static
+bool
+leave_cursor(
+	derive *d
+) {
+	ini_vsection *old = d->cursor;
+	d->cursor = NULL;
+	if (old == NULL || d->matched == old->count)
+		return true;
+	return new_builder(d, old->name, old, d->matched) != NULL;
+}
+
+static
+bool
+same_pair(
+	const ini_vsection *old,
+	size_t i,
+	const char *key,
+	const char *value
+) {
+	return i < old->count && strcmp(old->keys[i], key) == 0
+		&& strcmp(old->values[i], value) == 0;
+}
+
+/*
+ * find_builder
+ *
+ * the builder for a pair's section, or NULL with the cursor set if
+ * the pair matched without one.
+ *
+ * return: false if memory is exhausted
+ */
+
+static
+bool
+find_builder(
+	derive *d,
+	const char *section,
+	const char *key,
+	const char *value,
+	builder **found
+) {
+	*found = NULL;
+	ini_vsection *cursor = d->cursor;
+	if (cursor != NULL && strcmp(cursor->name, section) == 0) {
+		if (same_pair(cursor, d->matched, key, value)) {
+			d->matched += 1;
+			return true;
+		}
+		d->cursor = NULL;
+		*found = new_builder(d, section, cursor, d->matched);
+		return *found != NULL;
+	}
+	if (!leave_cursor(d))
+		return false;
+
+	if (d->current != NULL && strcmp(d->current->n.name, section) == 0) {
+		*found = d->current;
+		return true;
+	}
+	builder *b = (builder *)ini_table_find(&d->builders, section,
+			ini_hash_bytes(section, strlen(section), INI_HASH_SEED));
+	if (b != NULL) {
+		*found = d->current = b;
+		return true;
+	}
+
+	ini_vsection *old = NULL;
+	if (d->base != NULL)
+		old = lookup(d->base->root, section, name_hash(section));
+
+	/* met already and not in the table, it matched in full. */
+
+	if (old != NULL && old->met == d->serial) {
+		*found = new_builder(d, section, old, old->count);
+		return *found != NULL;
+	}
+	if (old != NULL) {
+		old->met = d->serial;
+		d->met += 1;
+		if (same_pair(old, 0, key, value)) {
+			d->cursor = old;
+			d->matched = 1;
+			return true;
+		}
+	}
+	*found = new_builder(d, section, old, 0);
+	return *found != NULL;
+}
+
+static
+bool
+cb_derive(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+) {
+	derive *d = user_data;
+	builder *b;
+	if (!find_builder(d, section, key, value, &b)) {
+		d->failed = true;
+		return true;
+	}
+	if (b == NULL)
+		return false;
+	if (!b->diverged) {
+		if (b->old != NULL && same_pair(b->old, b->matched, key, value)) {
+			b->matched += 1;
+			return false;
+		}
+		if (!diverge(b)) {
+			d->failed = true;
+			return true;
+		}
+	}
+	if (!append(b, key, value)) {
+		d->failed = true;
+		return true;
+	}
+	return false;
+}
+
+typedef struct key_at {
+	const char *key;
+	size_t i;
+} key_at;
+
+static
+int
+compare_keys(
+	const void *a,
+	const void *b
+) {
+	const key_at *x = a;
+	const key_at *y = b;
+	int c = strcmp(x->key, y->key);
+	if (c != 0)
+		return c;
+	return x->i < y->i ? -1 : x->i > y->i;
+}
+
+/*
+ * build_section
+ *
+ * the immutable section for a builder's pairs.
+ *
+ * return: the section holding one reference, or NULL if memory is
+ *         exhausted
+ */
+
+static
+ini_vsection *
+build_section(
+	builder *b
+) {
+	size_t count = b->count;
+	size_t name_len = strlen(b->n.name) + 1;
+	size_t size = sizeof(ini_vsection)
+		+ count * (2 * sizeof(char *) + sizeof(size_t))
+		+ name_len + b->len;
+	ini_vsection *s = malloc(size);
+	key_at *sorted = malloc((count ? count : 1) * sizeof(key_at));
+	if (s == NULL || sorted == NULL) {
+		free(s);
+		free(sorted);
+		return NULL;
+	}
+	s->refs = 1;
+	s->count = count;
+	s->keys = (const char **)(s + 1);
+	s->values = s->keys + count;
+	s->order = (size_t *)(s->values + count);
+	char *name = (char *)(s->order + count);
+	memcpy(name, b->n.name, name_len);
+	s->name = name;
+	s->hash = name_hash(name);
+	s->met = 0;
+	char *text = name + name_len;
+	if (b->len > 0)
+		memcpy(text, b->text, b->len);
+	for (size_t i = 0; i < count; i++) {
+		s->keys[i] = text;
+		text += strlen(text) + 1;
+		s->values[i] = text;
+		text += strlen(text) + 1;
+		sorted[i].key = s->keys[i];
+		sorted[i].i = i;
+	}
+	qsort(sorted, count, sizeof(key_at), compare_keys);
+	for (size_t i = 0; i < count; i++)
+		s->order[i] = sorted[i].i;
+	free(sorted);
+	return s;
+}
+
+typedef struct unseen {
+	uint64_t serial;
+	const char **names;
+	size_t count;
+	size_t capacity;
+	bool failed;
+} unseen;
+
+/* a walk visitor that notes sections the new file didn't have. */
+
+static
+bool
+note_unseen(
+	const ini_vsection *s,
+	void *user_data
+) {
+	unseen *u = user_data;
+	if (s->met == u->serial)
+		return false;
+	if (u->count == u->capacity) {
+		size_t bigger = u->capacity ? u->capacity * 2 : 16;
+		const char **names = realloc(u->names, bigger * sizeof(char *));
+		if (names == NULL) {
+			u->failed = true;
+			return true;
+		}
+		u->names = names;
+		u->capacity = bigger;
+	}
+	u->names[u->count++] = s->name;
+	return false;
+}
+
+static
+void
+free_builders(
+	derive *d
+) {
+	for (size_t i = 0; i < d->builders.count; i++) {
+		builder *b = (builder *)d->builders.order[i];
+		if (b->old == NULL)
+			free(b->n.name);
+		free(b->text);
+		free(b);
+	}
+	ini_table_free(&d->builders);
+}
+
+ini_version *
+ini_version_derive(
+	ini_version *base,
+	FILE *ini_file,
+	uint64_t serial,
+	ini_derive_stats *stats
+) {
+	if (base != NULL && serial == 0)
+		return NULL;
+	derive d = { base, serial, { 0 }, NULL, NULL, 0, 0, false };
+	int status = parse_ini(ini_file, &d, cb_derive);
+	if (status == EXIT_SUCCESS && !d.failed)
+		d.failed = !leave_cursor(&d);
+	ini_version *v = calloc(1, sizeof(ini_version));
+	if (status != EXIT_SUCCESS || d.failed || v == NULL) {
+		free(v);
+		free_builders(&d);
+		return NULL;
+	}
+	v->refs = 1;
+	v->number = base != NULL ? base->number + 1 : 1;
+	v->sections = base != NULL ? base->sections : 0;
+	v->root = base != NULL ? base->root : NULL;
+	if (v->root != NULL)
+		v->root->refs += 1;
+
+	/* every old section met is shared unless its builder says
+	 * otherwise. an unchanged section is already in the trie. */
+
+	ini_derive_stats counts = { 0, d.met, 0, 0 };
+	bool failed = false;
+
+	for (size_t i = 0; i < d.builders.count && !failed; i++) {
+		builder *b = (builder *)d.builders.order[i];
+		if (!b->diverged && b->old != NULL && b->matched == b->old->count)
+			continue;
+		if (b->old != NULL)
+			counts.shared -= 1;
+		if (!b->diverged && !diverge(b)) {
+			failed = true;
+			break;
+		}
+		ini_vsection *s = build_section(b);
+		if (s == NULL || !insert(&v->root, s, 0)) {
+			section_release(s);
+			failed = true;
+			break;
+		}
+		if (b->old == NULL)
+			v->sections += 1;
+		counts.built += 1;
+	}
+
+	/* if fewer of the old sections were seen than there were,
+	 * find the ones that are gone. */
+
+	if (!failed && base != NULL && d.met < base->sections) {
+		unseen u = { d.serial, NULL, 0, 0, false };
+		walk(base->root, note_unseen, &u);
+		failed = u.failed;
+		for (size_t i = 0; i < u.count && !failed; i++) {
+			failed = !remove_name(&v->root, u.names[i], name_hash(u.names[i]), 0);
+			v->sections -= 1;
+			counts.removed += 1;
+		}
+		free(u.names);
+	}
+
+	free_builders(&d);
+	if (failed) {
+		ini_version_release(v);
+		return NULL;
+	}
+	counts.sections = v->sections;
+	if (stats != NULL)
+		*stats = counts;
+	return v;
+}
+
+void
+ini_version_retain(
+	ini_version *v
+) {
+	v->refs += 1;
+}
+
+void
+ini_version_release(
+	ini_version *v
+) {
+	if (v == NULL || --v->refs > 0)
+		return;
+	node_release(v->root);
+	free(v);
+}
+
+size_t
+ini_version_number(
+	const ini_version *v
+) {
+	return v->number;
+}
+
+size_t
+ini_version_sections(
+	const ini_version *v
+) {
+	return v->sections;
+}
+
+const ini_vsection *
+ini_version_section(
+	const ini_version *v,
+	const char *name
+) {
+	return lookup(v->root, name, name_hash(name));
+}
+
+const char *
+ini_version_get(
+	const ini_version *v,
+	const char *section,
+	const char *key
+) {
+	const ini_vsection *s = ini_version_section(v, section);
+	return s != NULL ? ini_vsection_get(s, key) : NULL;
+}
+
+void
+ini_version_walk(
+	const ini_version *v,
+	fn_vsection_visit visit,
+	void *user_data
+) {
+	walk(v->root, visit, user_data);
+}
+
+const char *
+ini_vsection_name(
+	const ini_vsection *s
+) {
+	return s->name;
+}
+
+size_t
+ini_vsection_count(
+	const ini_vsection *s
+) {
+	return s->count;
+}
+
+bool
+ini_vsection_pair(
+	const ini_vsection *s,
+	size_t i,
+	const char **key,
+	const char **value
+) {
+	if (i >= s->count)
+		return false;
+	*key = s->keys[i];
+	*value = s->values[i];
+	return true;
+}
+
+/*
+ * ini_vsection_get
+ *
+ * the last of the run of equal keys in 'order' is the last in the
+ * file.
+ */
+
+const char *
+ini_vsection_get(
+	const ini_vsection *s,
+	const char *key
+) {
+	size_t lo = 0;
+	size_t hi = s->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcmp(s->keys[s->order[mid]], key) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0 && strcmp(s->keys[s->order[lo - 1]], key) == 0)
+		return s->values[s->order[lo - 1]];
+	return NULL;
+}
+
+/*
+ * the history holds its versions oldest first, the current one
+ * last. it is only ever a handful long, so dropping the oldest is
+ * a memmove.
+ */
+
+struct ini_history {
+	size_t depth;
+	size_t count;
+	uint64_t derives;    /* serial numbers used */
+	ini_version *versions[];
+};
+
+ini_history *
+ini_history_create(
+	size_t depth
+) {
+	if (depth == 0)
+		depth = 1;
+	ini_history *h = malloc(sizeof(ini_history) + depth * sizeof(ini_version *));
+	if (h != NULL) {
+		h->depth = depth;
+		h->count = 0;
+		h->derives = 0;
+	}
+	return h;
+}
+
+void
+ini_history_free(
+	ini_history *h
+) {
+	if (h == NULL)
+		return;
+	for (size_t i = 0; i < h->count; i++)
+		ini_version_release(h->versions[i]);
+	free(h);
+}
+
+const ini_version *
+ini_history_reload(
+	ini_history *h,
+	FILE *ini_file,
+	ini_derive_stats *stats
+) {
+	ini_version *current = h->count > 0 ? h->versions[h->count - 1] : NULL;
+	ini_version *v = ini_version_derive(current, ini_file, ++h->derives, stats);
+	if (v == NULL)
+		return NULL;
+	if (h->count == h->depth) {
+		ini_version_release(h->versions[0]);
+		memmove(&h->versions[0], &h->versions[1],
+			(h->count - 1) * sizeof(ini_version *));
+		h->count -= 1;
+	}
+	h->versions[h->count++] = v;
+	return v;
+}
+
+bool
+ini_history_rollback(
+	ini_history *h
+) {
+	if (h->count < 2)
+		return false;
+	h->count -= 1;
+	ini_version_release(h->versions[h->count]);
+	return true;
+}
+
+const ini_version *
+ini_history_current(
+	const ini_history *h
+) {
+	return h->count > 0 ? h->versions[h->count - 1] : NULL;
+}
+
+size_t
+ini_history_count(
+	const ini_history *h
+) {
+	return h->count;
+}
+
+const ini_version *
+ini_history_at(
+	const ini_history *h,
+	size_t age
+) {
+	return age < h->count ? h->versions[h->count - 1 - age] : NULL;
+}
+
+/* iniversion.c ends here */
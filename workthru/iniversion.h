@@ -0,0 +1,263 @@
+/* iniversion.h -- immutable config versions that share unchanged sections */
+
+#ifndef INIVERSION_H
+#define INIVERSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "iniparser.h"
+
+/*
+ * a version is an immutable snapshot of a parsed ini file: its
+ * sections, each with its pairs in file order. a section that
+ * appears more than once in the file is one section, its pairs in
+ * the order they were read. sections without pairs are not kept,
+ * parse_ini never reports them.
+ *
+ * versions are persistent. a new version is derived from an old one
+ * by parsing the new file against it, and each section whose pairs
+ * came out exactly as before is the old section, shared, not a copy.
+ * only changed and new sections are allocated, and only the path
+ * to each of them in the version's trie is copied. the parse itself
+ * still reads the whole file, but it compares pairs against the old
+ * section as they arrive and copies nothing until one differs.
+ *
+ * sections hang off a hash array mapped trie on their names, 32 ways
+ * per level, so a lookup is a few steps and a version holds about
+ * one small node per 32 sections besides its sections. sections and
+ * nodes are reference counted. a version or section obtained from
+ * one of these functions stays valid while its version is held.
+ *
+ * an ini_history keeps the last N versions. reload derives a new
+ * version from the current one and makes it current, releasing the
+ * oldest if there are already N. rollback drops the current version
+ * and makes the one before it current again. both cost the changed
+ * sections, not the whole file, in allocation.
+ *
+ *   ini_history *h = ini_history_create(4);
+ *   ini_history_reload(h, file, NULL);
+ *   ...
+ *   if (ini_history_reload(h, file, NULL) && !valid(ini_history_current(h)))
+ *           ini_history_rollback(h);
+ *
+ * reference counts are not atomic, and a derive stamps the base's
+ * sections as it meets them. share versions between threads, and
+ * derive from them, only behind a lock. histories that share no
+ * versions need no lock between them.
+ */
+
+typedef struct ini_version ini_version;
+typedef struct ini_vsection ini_vsection;
+typedef struct ini_history ini_history;
+
+/*
+ * what a derive did.
+ *
+ * sections: sections in the new version.
+ * shared  : of those, unchanged and shared with the base.
+ * built   : new or changed, allocated for the new version.
+ * removed : in the base but not in the new file.
+ */
+
+typedef struct ini_derive_stats {
+	size_t sections;
+	size_t shared;
+	size_t built;
+	size_t removed;
+} ini_derive_stats;
+
+/*
+ * ini_version_derive
+ *
+ * parse a file into a new version, sharing what it can with base.
+ * the derive stamps base's sections with 'serial' as it meets them,
+ * which is why base is not const. the versions themselves don't
+ * change.
+ *
+ * serial must not be 0, and must not have been used by another
+ * derive from base or from any version base shares sections with,
+ * its ancestors and their other descendants. an ini_history counts
+ * them for its own derives. with no base it is not used.
+ *
+ * in/out: the version to share with, or NULL for none
+ * in/out: file stream on an ini file
+ * in    : serial number of this derive
+ * out   : what was shared and built, may be NULL
+ * return: a new version holding one reference, or NULL on a parse
+ *         or memory error, or a serial of 0
+ */
+
+ini_version *
+ini_version_derive(
+	ini_version *base,
+	FILE *ini_file,
+	uint64_t serial,
+	ini_derive_stats *stats
+);
+
+/* take and drop a reference. the last release frees the version. */
+
+void
+ini_version_retain(
+	ini_version *v
+);
+
+void
+ini_version_release(
+	ini_version *v
+);
+
+/* 1 for a version derived from nothing, one more than its base. */
+
+size_t
+ini_version_number(
+	const ini_version *v
+);
+
+size_t
+ini_version_sections(
+	const ini_version *v
+);
+
+/* the section named, or NULL. */
+
+const ini_vsection *
+ini_version_section(
+	const ini_version *v,
+	const char *name
+);
+
+/*
+ * ini_version_get
+ *
+ * the value of section:key. if the key was repeated, the last
+ * occurrence.
+ *
+ * return: the value or NULL if not found
+ */
+
+const char *
+ini_version_get(
+	const ini_version *v,
+	const char *section,
+	const char *key
+);
+
+/*
+ * visit every section, in no particular order but the same one for
+ * the same set of names. return true from the visitor to stop.
+ */
+
+typedef
+bool
+(*fn_vsection_visit)(
+	const ini_vsection *section,
+	void *user_data
+);
+
+void
+ini_version_walk(
+	const ini_version *v,
+	fn_vsection_visit visit,
+	void *user_data
+);
+
+/* a section's name, its pairs in file order, and a key lookup. */
+
+const char *
+ini_vsection_name(
+	const ini_vsection *s
+);
+
+size_t
+ini_vsection_count(
+	const ini_vsection *s
+);
+
+bool
+ini_vsection_pair(
+	const ini_vsection *s,
+	size_t i,
+	const char **key,
+	const char **value
+);
+
+const char *
+ini_vsection_get(
+	const ini_vsection *s,
+	const char *key
+);
+
+/*
+ * ini_history_create
+ *
+ * in    : how many versions to keep, at least 1
+ * return: an empty history or NULL if memory is exhausted
+ */
+
+ini_history *
+ini_history_create(
+	size_t depth
+);
+
+void
+ini_history_free(
+	ini_history *h
+);
+
+/*
+ * ini_history_reload
+ *
+ * derive a version from the current one and make it current. on an
+ * error the history is unchanged.
+ *
+ * return: the new current version, or NULL on a parse or memory
+ *         error
+ */
+
+const ini_version *
+ini_history_reload(
+	ini_history *h,
+	FILE *ini_file,
+	ini_derive_stats *stats
+);
+
+/*
+ * ini_history_rollback
+ *
+ * release the current version and go back to the one before it.
+ *
+ * return: false if there is no version before it
+ */
+
+bool
+ini_history_rollback(
+	ini_history *h
+);
+
+/* the current version, or NULL if nothing has been loaded. */
+
+const ini_version *
+ini_history_current(
+	const ini_history *h
+);
+
+/* versions held, and the one 'age' reloads back, 0 is current. */
+
+size_t
+ini_history_count(
+	const ini_history *h
+);
+
+const ini_version *
+ini_history_at(
+	const ini_history *h,
+	size_t age
+);
+
+#endif /* INIVERSION_H */
+
+/* iniversion.h ends here */
@@ -0,0 +1,1035 @@
+/* iniwrite.c -- edit an ini file in place, keeping everything else */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "inienc.h"
+#include "inihash.h"
+#include "iniparser.h"
+#include "iniwrite.h"
+
+/*
+ * the file is mapped and parsed once with a span hook. each header
+ * moves its section's insertion point to just past the header, and
+ * each pair adds a line record and moves the insertion point past
+ * itself, so the insertion point ends up after the last pair of the
+ * section's last appearance.
+ *
+ * sections are kept in an ini_table as in inidupes.c, and each
+ * section chains its lines in file order. section and key names are
+ * copied into a few large blocks rather than one allocation each.
+ *
+ * a section's keys go into an ini_table of their own the first time
+ * an edit touches the section, by walking its chain. a key holds
+ * the index of its latest line, and each line the index of the
+ * occurrence before it, so set finds the last live one by walking
+ * back from the head. sections no edit touches are never indexed.
+ *
+ * edits only mark line records: deleted, a new value, or a new line
+ * added to the end of the records. writing turns the marks into a
+ * list of edits by offset in the old file, sorts it, and walks it
+ * emitting old runs and new text as iovecs.
+ */
+
+typedef struct wkey {
+	ini_named n;
+	size_t last;         /* 1 + index of latest line, 0 none */
+} wkey;
+
+typedef struct wsec {
+	ini_named n;
+	ini_table keys;      /* empty until indexed              */
+	bool indexed;
+	size_t head;         /* 1 + index of first and last line */
+	size_t tail;
+	size_t insert_at;    /* offset for added pairs           */
+	size_t group;        /* 0, or order of a new section     */
+} wsec;
+
+typedef struct wline {
+	wsec *sec;
+	const char *name;    /* the key, in a name block         */
+	size_t next;         /* 1 + index of next in section     */
+	size_t start;        /* span from the parse, or for an   */
+	size_t end;          /* added line all are insert_at     */
+	size_t value_start;
+	size_t prev;         /* 1 + index of earlier occurrence  */
+	size_t seq;          /* order added, for added lines     */
+	char *value;         /* new value, NULL if unchanged     */
+	bool deleted;
+	bool added;
+} wline;
+
+/* a block of names. */
+
+#define NAME_BLOCK 65536
+
+typedef struct wnames {
+	struct wnames *next;
+	size_t used;
+	size_t size;
+	char text[];
+} wnames;
+
+struct ini_writer {
+	char *path;
+	mode_t mode;
+	const char *text;    /* the mapped file                  */
+	size_t len;
+	size_t bom;          /* length of a UTF-8 BOM, or 0      */
+	const char *eol;     /* the file's line ending           */
+	ini_table sections;
+	wsec *current;
+	wline *lines;
+	wnames *names;
+	size_t count;
+	size_t capacity;
+	size_t seq;
+	size_t groups;
+	bool failed;         /* the load hit a problem           */
+	bool stale;          /* committed, reread before use     */
+};
+
+static
+char *
+copy_string(
+	const char *s,
+	size_t len
+) {
+	char *p = malloc(len + 1);
+	if (p != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return p;
+}
+
+/*
+ * keep_name
+ *
+ * copy a section or key name into the current name block.
+ *
+ * return: the copy, or NULL if memory is exhausted
+ */
+
+static
+const char *
+keep_name(
+	ini_writer *w,
+	const char *name
+) {
+	size_t len = strlen(name) + 1;
+	if (w->names == NULL || w->names->size - w->names->used < len) {
+		size_t size = len > NAME_BLOCK ? len : NAME_BLOCK;
+		wnames *block = malloc(sizeof(wnames) + size);
+		if (block == NULL)
+			return NULL;
+		block->next = w->names;
+		block->used = 0;
+		block->size = size;
+		w->names = block;
+	}
+	char *p = w->names->text + w->names->used;
+	memcpy(p, name, len);
+	w->names->used += len;
+	return p;
+}
+
+/*
+ * find_section
+ *
+ * the record for a section. a section not in the file is created
+ * if 'create' is set, to be written at the end of the file. ""
+ * always exists, its pairs go at the start of the file.
+ */
+
+static
+wsec *
+find_section(
+	ini_writer *w,
+	const char *section,
+	bool create
+) {
+	if (w->current != NULL && strcmp(w->current->n.name, section) == 0)
+		return w->current;
+
+	size_t len = strlen(section);
+	uint64_t hash = ini_hash_bytes(section, len, INI_HASH_SEED);
+	wsec *s = (wsec *)ini_table_find(&w->sections, section, hash);
+	if (s != NULL || !create)
+		return s != NULL ? w->current = s : NULL;
+
+	s = calloc(1, sizeof(wsec));
+	if (s == NULL)
+		return NULL;
+	s->n.name = (char *)keep_name(w, section);
+	s->n.hash = hash;
+	if (s->n.name == NULL || !ini_table_add(&w->sections, &s->n)) {
+		free(s);
+		return NULL;
+	}
+	return w->current = s;
+}
+
+static
+wkey *
+find_key(
+	ini_writer *w,
+	wsec *s,
+	const char *key,
+	bool create
+) {
+	size_t len = strlen(key);
+	uint64_t hash = ini_hash_bytes(key, len, INI_HASH_SEED);
+	wkey *k = (wkey *)ini_table_find(&s->keys, key, hash);
+	if (k != NULL || !create)
+		return k;
+
+	k = calloc(1, sizeof(wkey));
+	if (k == NULL)
+		return NULL;
+	k->n.name = (char *)keep_name(w, key);
+	k->n.hash = hash;
+	if (k->n.name == NULL || !ini_table_add(&s->keys, &k->n)) {
+		free(k);
+		return NULL;
+	}
+	return k;
+}
+
+/*
+ * new_line
+ *
+ * add a line record to the end of a section's chain. for an indexed
+ * section it is also linked in as its key's latest occurrence.
+ *
+ * return: the record, or NULL if memory is exhausted
+ */
+
+static
+wline *
+new_line(
+	ini_writer *w,
+	wsec *s,
+	const char *name,
+	wkey *k
+) {
+	if (w->count == w->capacity) {
+		size_t capacity = w->capacity ? w->capacity * 2 : 256;
+		wline *lines = realloc(w->lines, capacity * sizeof(wline));
+		if (lines == NULL)
+			return NULL;
+		w->lines = lines;
+		w->capacity = capacity;
+	}
+	wline *l = &w->lines[w->count];
+	memset(l, 0, sizeof(wline));
+	l->sec = s;
+	l->name = name;
+	w->count += 1;
+	if (s->tail != 0)
+		w->lines[s->tail - 1].next = w->count;
+	else
+		s->head = w->count;
+	s->tail = w->count;
+	if (k != NULL) {
+		l->prev = k->last;
+		k->last = w->count;
+	}
+	return l;
+}
+
+/*
+ * index_section
+ *
+ * build a section's key table from its chain of lines.
+ *
+ * return: false if memory is exhausted
+ */
+
+static
+bool
+index_section(
+	ini_writer *w,
+	wsec *s
+) {
+	if (s->indexed)
+		return true;
+	for (size_t i = s->head; i != 0; i = w->lines[i - 1].next) {
+		wline *l = &w->lines[i - 1];
+		wkey *k = find_key(w, s, l->name, true);
+		if (k == NULL)
+			return false;
+		l->prev = k->last;
+		k->last = i;
+	}
+	s->indexed = true;
+	return true;
+}
+
+/*
+ * on_span
+ *
+ * the parser's span hook, called for each header and pair.
+ */
+
+static
+void
+on_span(
+	const ini_span *span,
+	void *user_data
+) {
+	ini_writer *w = user_data;
+	if (w->failed)
+		return;
+	wsec *s = find_section(w, span->section, true);
+	if (s == NULL) {
+		w->failed = true;
+		return;
+	}
+	s->insert_at = span->end + w->bom;
+	if (span->key == NULL)
+		return;
+	const char *name = keep_name(w, span->key);
+	wline *l = name != NULL ? new_line(w, s, name, NULL) : NULL;
+	if (l == NULL) {
+		w->failed = true;
+		return;
+	}
+	l->start = span->start + w->bom;
+	l->end = span->end + w->bom;
+	l->value_start = span->value_start + w->bom;
+}
+
+static
+bool
+cb_ignore(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *user_data
+) {
+	return false;
+}
+
+typedef struct memory {
+	const char *text;
+	size_t len;
+	size_t pos;
+} memory;
+
+static
+long
+read_memory(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	memory *m = handle;
+	size_t n = m->len - m->pos < buflen ? m->len - m->pos : buflen;
+	memcpy(buffer, m->text + m->pos, n);
+	m->pos += n;
+	return n;
+}
+
+/*
+ * unload
+ *
+ * drop the mapping and every record, keeping the path.
+ */
+
+static
+void
+unload(
+	ini_writer *w
+) {
+	for (size_t i = 0; i < w->count; i++)
+		free(w->lines[i].value);
+	free(w->lines);
+	w->lines = NULL;
+	w->count = 0;
+	w->capacity = 0;
+	for (size_t i = 0; i < w->sections.count; i++) {
+		wsec *s = (wsec *)w->sections.order[i];
+		for (size_t j = 0; j < s->keys.count; j++) {
+			free(s->keys.order[j]);
+		}
+		ini_table_free(&s->keys);
+		free(s);
+	}
+	while (w->names != NULL) {
+		wnames *next = w->names->next;
+		free(w->names);
+		w->names = next;
+	}
+	ini_table_free(&w->sections);
+	memset(&w->sections, 0, sizeof(ini_table));
+	w->current = NULL;
+	if (w->len > 0)
+		munmap((void *)w->text, w->len);
+	w->text = NULL;
+	w->len = 0;
+	w->bom = 0;
+	w->seq = 0;
+	w->groups = 0;
+}
+
+/*
+ * find_bom
+ *
+ * let a decoder look at the start of the file. a UTF-8 BOM is kept
+ * as it is and the parse starts after it, with every span moved up
+ * by its length. UTF-16 is refused, spans into transcoded text are
+ * not offsets into the file.
+ *
+ * return: false for UTF-16 or if memory is exhausted
+ */
+
+static
+bool
+find_bom(
+	ini_writer *w
+) {
+	memory m = { w->text, w->len < 4 ? w->len : 4, 0 };
+	ini_decoder *d = ini_decoder_open(read_memory, &m, INI_ENC_DETECT);
+	if (d == NULL)
+		return false;
+	char buffer[8];
+	ini_decoder_read(d, buffer, sizeof(buffer));
+	int encoding = ini_decoder_encoding(d);
+	ini_decoder_close(d);
+	if (encoding == INI_ENC_UTF16LE || encoding == INI_ENC_UTF16BE)
+		return false;
+	w->bom = encoding == INI_ENC_UTF8_BOM ? 3 : 0;
+	return true;
+}
+
+/*
+ * load
+ *
+ * map the file at w->path and parse it for spans.
+ *
+ * return: true if it could be read and parsed
+ */
+
+static
+bool
+load(
+	ini_writer *w
+) {
+	int fd = open(w->path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	w->mode = st.st_mode & 07777;
+	w->len = st.st_size;
+	if (w->len > 0) {
+		void *p = mmap(NULL, w->len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			w->len = 0;
+			close(fd);
+			return false;
+		}
+		w->text = p;
+	}
+	close(fd);
+
+	const char *nl = w->len > 0 ? memchr(w->text, '\n', w->len) : NULL;
+	w->eol = nl != NULL && nl > w->text && nl[-1] == '\r' ? "\r\n" : "\n";
+
+	if (!find_bom(w))
+		return false;
+
+	/* "" is there from the start, its pairs go at the front. */
+
+	wsec *front = find_section(w, "", true);
+	if (front == NULL)
+		return false;
+	front->insert_at = w->bom;
+
+	memory m = { w->text + w->bom, w->len - w->bom, 0 };
+	ini_options options = { 0 };
+	options.span = on_span;
+	int status = parse_ini_reader(read_memory, &m, w, cb_ignore, &options);
+	return status == EXIT_SUCCESS && !w->failed;
+}
+
+ini_writer *
+ini_writer_open(
+	const char *path
+) {
+	ini_writer *w = calloc(1, sizeof(ini_writer));
+	if (w == NULL)
+		return NULL;
+	w->path = copy_string(path, strlen(path));
+	if (w->path == NULL || !load(w)) {
+		ini_writer_close(w);
+		return NULL;
+	}
+	return w;
+}
+
+void
+ini_writer_close(
+	ini_writer *w
+) {
+	if (w == NULL)
+		return;
+	unload(w);
+	free(w->path);
+	free(w);
+}
+
+/*
+ * fresh
+ *
+ * after a commit the file is reread when it's next needed, so a
+ * commit doesn't pay for a parse that may never be used.
+ *
+ * return: true if the writer is ready for use
+ */
+
+static
+bool
+fresh(
+	ini_writer *w
+) {
+	if (w->stale) {
+		w->stale = false;
+		w->failed = !load(w);
+	}
+	return !w->failed;
+}
+
+/*
+ * writable
+ *
+ * a section, key, and value that will read back as themselves: no
+ * \n anywhere, no ] in a section, no = in a key, a key that
+ * doesn't look like a comment or header, and nothing longer than
+ * the parser keeps.
+ */
+
+static
+bool
+writable(
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	if (strlen(section) > INI_SEC_MAXLEN
+		|| strchr(section, '\n') || strchr(section, ']'))
+		return false;
+	if (key != NULL) {
+		if (key[0] == '\0' || strchr("#;[ \t\r", key[0])
+			|| strchr(key, '\n') || strchr(key, '='))
+			return false;
+		size_t len = strlen(key);
+		if (len > INI_KEY_MAXLEN || strchr(" \t\r", key[len - 1]))
+			return false;
+	}
+	return value == NULL
+		|| (strlen(value) <= INI_VAL_MAXLEN && strchr(value, '\n') == NULL);
+}
+
+/*
+ * add_line
+ *
+ * a new pair at the section's insertion point.
+ */
+
+static
+int
+add_line(
+	ini_writer *w,
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	wsec *s = find_section(w, section, false);
+	if (s == NULL) {
+		s = find_section(w, section, true);
+		if (s == NULL)
+			return EXIT_FAILURE;
+		s->insert_at = w->len;
+		s->group = ++w->groups;
+		s->indexed = true;
+	}
+	if (!index_section(w, s))
+		return EXIT_FAILURE;
+	wkey *k = find_key(w, s, key, true);
+	char *copy = copy_string(value, strlen(value));
+	wline *l = k != NULL && copy != NULL ? new_line(w, s, k->n.name, k) : NULL;
+	if (l == NULL) {
+		free(copy);
+		return EXIT_FAILURE;
+	}
+	l->start = l->end = l->value_start = s->insert_at;
+	l->seq = ++w->seq;
+	l->value = copy;
+	l->added = true;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * value_range
+ *
+ * the bytes of an original line's value, trailing whitespace and
+ * line ending left out. an empty value is the empty run just past
+ * the '=' and *empty is set, the whitespace after it up to the
+ * line ending is replaced along with it.
+ */
+
+static
+void
+value_range(
+	const ini_writer *w,
+	const wline *l,
+	size_t *from,
+	size_t *to,
+	size_t *term,
+	bool *empty
+) {
+	const char *t = w->text;
+	size_t e = l->end;
+	if (e > l->start && t[e - 1] == '\n')
+		e -= 1;
+	if (e > l->start && t[e - 1] == '\r')
+		e -= 1;
+	*term = e;
+	*empty = l->value_start >= e;
+	size_t stop = *empty ? l->start : l->value_start;
+	while (e > stop && (t[e - 1] == ' ' || t[e - 1] == '\t' || t[e - 1] == '\r'))
+		e -= 1;
+	*from = *empty ? e : l->value_start;
+	*to = e;
+}
+
+int
+ini_writer_set(
+	ini_writer *w,
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	if (!writable(section, key, value) || !fresh(w))
+		return EXIT_FAILURE;
+	wsec *s = find_section(w, section, false);
+	if (s != NULL && !index_section(w, s))
+		return EXIT_FAILURE;
+	wkey *k = s != NULL ? find_key(w, s, key, false) : NULL;
+	size_t i = k != NULL ? k->last : 0;
+	while (i != 0 && w->lines[i - 1].deleted)
+		i = w->lines[i - 1].prev;
+	if (i == 0)
+		return add_line(w, section, key, value);
+
+	wline *l = &w->lines[i - 1];
+	size_t len = strlen(value);
+	char *copy = NULL;
+
+	/* setting an original line back to what it was undoes the
+	 * change instead of rewriting the same bytes. */
+
+	if (!l->added) {
+		size_t from, to, term;
+		bool empty;
+		value_range(w, l, &from, &to, &term, &empty);
+		if (len == (empty ? 0 : to - from)
+			&& memcmp(w->text + from, value, len) == 0) {
+			free(l->value);
+			l->value = NULL;
+			return EXIT_SUCCESS;
+		}
+	}
+	copy = copy_string(value, len);
+	if (copy == NULL)
+		return EXIT_FAILURE;
+	free(l->value);
+	l->value = copy;
+	return EXIT_SUCCESS;
+}
+
+int
+ini_writer_add(
+	ini_writer *w,
+	const char *section,
+	const char *key,
+	const char *value
+) {
+	if (!writable(section, key, value) || !fresh(w))
+		return EXIT_FAILURE;
+	return add_line(w, section, key, value);
+}
+
+int
+ini_writer_delete(
+	ini_writer *w,
+	const char *section,
+	const char *key
+) {
+	if (!writable(section, key, NULL) || !fresh(w))
+		return EXIT_FAILURE;
+	wsec *s = find_section(w, section, false);
+	if (s != NULL && !index_section(w, s))
+		return EXIT_FAILURE;
+	wkey *k = s != NULL ? find_key(w, s, key, false) : NULL;
+	for (size_t i = k != NULL ? k->last : 0; i != 0; i = w->lines[i - 1].prev) {
+		wline *l = &w->lines[i - 1];
+		l->deleted = true;
+		free(l->value);
+		l->value = NULL;
+	}
+	return EXIT_SUCCESS;
+}
+
+size_t
+ini_writer_changes(
+	const ini_writer *w
+) {
+	size_t changes = 0;
+	if (w->stale)
+		return 0;
+	for (size_t i = 0; i < w->count; i++) {
+		const wline *l = &w->lines[i];
+		if (l->added ? !l->deleted : l->deleted || l->value != NULL)
+			changes += 1;
+	}
+	return changes;
+}
+
+/*
+ * an edit to the old file: replace the bytes from offset up to
+ * skip_to with text. an insertion has skip_to == offset. edits at
+ * the same offset go in order of group, new sections last in the
+ * order they were made, and then of seq.
+ */
+
+typedef struct wedit {
+	size_t offset;
+	size_t skip_to;
+	size_t group;
+	size_t seq;
+	const char *text;
+	size_t len;
+	char *own;           /* text to free, if built for this edit */
+} wedit;
+
+static
+int
+compare_edits(
+	const void *a,
+	const void *b
+) {
+	const wedit *x = a;
+	const wedit *y = b;
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	if (x->group != y->group)
+		return x->group < y->group ? -1 : 1;
+	if (x->seq != y->seq)
+		return x->seq < y->seq ? -1 : 1;
+	return 0;
+}
+
+/*
+ * join
+ *
+ * up to four strings into one new one.
+ */
+
+static
+char *
+join(
+	const char *a,
+	const char *b,
+	const char *c,
+	const char *d,
+	size_t *len
+) {
+	size_t la = strlen(a);
+	size_t lb = strlen(b);
+	size_t lc = strlen(c);
+	size_t ld = strlen(d);
+	*len = la + lb + lc + ld;
+	char *p = malloc(*len + 1);
+	if (p == NULL)
+		return NULL;
+	memcpy(p, a, la);
+	memcpy(p + la, b, lb);
+	memcpy(p + la + lb, c, lc);
+	memcpy(p + la + lb + lc, d, ld);
+	p[*len] = '\0';
+	return p;
+}
+
+/*
+ * make_edits
+ *
+ * turn the marked line records into a sorted list of edits.
+ *
+ * out   : the edits, free them with free_edits
+ * return: how many, or (size_t)-1 if memory is exhausted
+ */
+
+static
+void
+free_edits(
+	wedit *edits,
+	size_t count
+) {
+	for (size_t i = 0; i < count; i++)
+		free(edits[i].own);
+	free(edits);
+}
+
+static
+size_t
+make_edits(
+	ini_writer *w,
+	wedit **out
+) {
+	/* at most one edit per line, one header per new section, and
+	 * a line ending for a file without a final one. */
+
+	wedit *edits = calloc(w->count + w->groups + 1, sizeof(wedit));
+	if (edits == NULL)
+		return (size_t)-1;
+	size_t n = 0;
+	bool at_end = false;
+	size_t new_sections = 0;
+
+	for (size_t i = 0; i < w->count; i++) {
+		wline *l = &w->lines[i];
+		wedit *e = &edits[n];
+		if (l->added) {
+			if (l->deleted)
+				continue;
+			e->offset = e->skip_to = l->start;
+			e->group = l->sec->group;
+			e->seq = l->seq;
+			e->own = join(l->name, " = ", l->value, w->eol, &e->len);
+			at_end |= l->start == w->len;
+		} else if (l->deleted) {
+			e->offset = l->start;
+			e->skip_to = l->end;
+		} else if (l->value != NULL) {
+			size_t from, to, term;
+			bool empty;
+			value_range(w, l, &from, &to, &term, &empty);
+			e->offset = from;
+			e->skip_to = empty ? term : to;
+			e->own = join(empty ? " " : "", l->value, "", "", &e->len);
+		} else
+			continue;
+		if ((l->added || l->value != NULL) && e->own == NULL) {
+			free_edits(edits, n);
+			return (size_t)-1;
+		}
+		e->text = e->own;
+		n += 1;
+	}
+
+	/* headers for new sections that kept a pair. */
+
+	for (size_t i = 0; i < w->sections.count; i++) {
+		wsec *s = (wsec *)w->sections.order[i];
+		if (s->group == 0)
+			continue;
+		bool live = false;
+		for (size_t x = s->head; x != 0 && !live; x = w->lines[x - 1].next)
+			live = !w->lines[x - 1].deleted;
+		if (!live)
+			continue;
+		wedit *e = &edits[n];
+		bool gap = w->len > w->bom || new_sections > 0;
+		e->offset = e->skip_to = w->len;
+		e->group = s->group;
+		size_t room = strlen(s->n.name) + 2 * strlen(w->eol) + 3;
+		e->own = malloc(room);
+		if (e->own != NULL)
+			e->len = snprintf(e->own, room, "%s[%s]%s",
+					gap ? w->eol : "", s->n.name, w->eol);
+		if (e->own == NULL) {
+			free_edits(edits, n);
+			return (size_t)-1;
+		}
+		e->text = e->own;
+		n += 1;
+		new_sections += 1;
+		at_end = true;
+	}
+
+	/* a file that doesn't end with a line ending needs one before
+	 * anything is added after its last line. */
+
+	if (at_end && w->len > w->bom && w->text[w->len - 1] != '\n') {
+		wedit *e = &edits[n++];
+		e->offset = e->skip_to = w->len;
+		e->text = w->eol;
+		e->len = strlen(w->eol);
+	}
+
+	qsort(edits, n, sizeof(wedit), compare_edits);
+	*out = edits;
+	return n;
+}
+
+/*
+ * write_all
+ *
+ * writev a list of iovecs, coping with short writes.
+ */
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static
+bool
+write_all(
+	int fd,
+	struct iovec *iov,
+	size_t count
+) {
+	while (count > 0) {
+		int batch = count < IOV_MAX ? count : IOV_MAX;
+		ssize_t put = writev(fd, iov, batch);
+		if (put < 0)
+			return false;
+		while (count > 0 && (size_t)put >= iov->iov_len) {
+			put -= iov->iov_len;
+			iov += 1;
+			count -= 1;
+		}
+		if (count > 0 && put > 0) {
+			iov->iov_base = (char *)iov->iov_base + put;
+			iov->iov_len -= put;
+		}
+	}
+	return true;
+}
+
+int
+ini_writer_write(
+	ini_writer *w,
+	int fd
+) {
+	if (!fresh(w))
+		return EXIT_FAILURE;
+	wedit *edits;
+	size_t n = make_edits(w, &edits);
+	if (n == (size_t)-1)
+		return EXIT_FAILURE;
+
+	/* an old run and new text per edit, and the tail. */
+
+	struct iovec *iov = malloc((2 * n + 1) * sizeof(struct iovec));
+	if (iov == NULL) {
+		free_edits(edits, n);
+		return EXIT_FAILURE;
+	}
+	size_t count = 0;
+	size_t cursor = 0;
+	for (size_t i = 0; i < n; i++) {
+		wedit *e = &edits[i];
+		if (e->offset > cursor) {
+			iov[count].iov_base = (char *)w->text + cursor;
+			iov[count].iov_len = e->offset - cursor;
+			count += 1;
+		}
+		if (e->len > 0) {
+			iov[count].iov_base = (char *)e->text;
+			iov[count].iov_len = e->len;
+			count += 1;
+		}
+		if (e->skip_to > cursor)
+			cursor = e->skip_to;
+	}
+	if (w->len > cursor) {
+		iov[count].iov_base = (char *)w->text + cursor;
+		iov[count].iov_len = w->len - cursor;
+		count += 1;
+	}
+
+	bool ok = write_all(fd, iov, count);
+	free(iov);
+	free_edits(edits, n);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * sync_directory
+ *
+ * flush the directory holding path, so the rename is on disk too.
+ */
+
+static
+void
+sync_directory(
+	const char *path
+) {
+	const char *slash = strrchr(path, '/');
+	char *dir = slash == NULL ? copy_string(".", 1)
+		: copy_string(path, slash == path ? 1 : (size_t)(slash - path));
+	if (dir == NULL)
+		return;
+	int fd = open(dir, O_RDONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	free(dir);
+}
+
+int
+ini_writer_commit(
+	ini_writer *w
+) {
+	if (!fresh(w))
+		return EXIT_FAILURE;
+	size_t len;
+	char *temp = join(w->path, ".XXXXXX", "", "", &len);
+	if (temp == NULL)
+		return EXIT_FAILURE;
+	int fd = mkstemp(temp);
+	if (fd < 0) {
+		free(temp);
+		return EXIT_FAILURE;
+	}
+	bool ok = fchmod(fd, w->mode) == 0
+		&& ini_writer_write(w, fd) == EXIT_SUCCESS
+		&& fsync(fd) == 0;
+	ok = close(fd) == 0 && ok;
+	if (ok)
+		ok = rename(temp, w->path) == 0;
+	if (!ok) {
+		unlink(temp);
+		free(temp);
+		return EXIT_FAILURE;
+	}
+	free(temp);
+	sync_directory(w->path);
+
+	unload(w);
+	w->stale = true;
+	return EXIT_SUCCESS;
+}
+
+/* iniwrite.c ends here */
@@ -0,0 +1,144 @@
+/* iniwrite.h -- edit an ini file in place, keeping everything else */
+
+#ifndef INIWRITE_H
+#define INIWRITE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "iniparser.h"
+
+/*
+ * the writer opens an ini file, parses it once to learn where each
+ * section header and pair lies (see ini_span in iniparser.h), and
+ * then takes a batch of edits:
+ *
+ *   set    - change the value of the last occurrence of a key, or
+ *            add the key if it isn't there.
+ *   add    - add a pair even if the key is already there.
+ *   delete - remove every occurrence of a key.
+ *
+ * nothing is written until the batch is written out. the new file
+ * is the old one with only the edited lines changed: comments,
+ * blank lines, spacing, line endings, and the order of everything
+ * are kept. a set replaces just the value's bytes. a deleted pair
+ * loses its whole line. an added pair goes after the last pair of
+ * the last appearance of its section, and a section that isn't in
+ * the file is added at the end. added lines use " = " and the
+ * file's line ending.
+ *
+ * the unchanged runs of the old file are written straight from a
+ * mapping of it with writev, between the few new lines, so a batch
+ * that touches a handful of lines in a large file costs about one
+ * copy of the file through the kernel.
+ *
+ * ini_writer_commit replaces the file atomically: the new text goes
+ * to a temporary file in the same directory, is flushed to disk,
+ * and is renamed over the old one. readers see either the old file
+ * or the new one. the writer rereads the new file when the next
+ * batch starts.
+ *
+ * a file that starts with a UTF-8 byte order mark keeps it, and the
+ * mark is not part of the first name. UTF-16 files are refused,
+ * ini_writer_open fails on them: the parse would see transcoded
+ * text whose offsets are not offsets into the file.
+ *
+ * names are matched exactly as the parser reports them, trimmed.
+ * pairs before the first header are in section "". a value is
+ * written as given, it may not contain a \n, and leading and
+ * trailing whitespace in it will be trimmed when it is read back.
+ * names longer than INI_SEC_MAXLEN or INI_KEY_MAXLEN and values
+ * longer than INI_VAL_MAXLEN are refused, the parser would cut
+ * them short.
+ *
+ * the edit functions return EXIT_SUCCESS or EXIT_FAILURE, failing
+ * on memory or on a name or value that can't be written as one
+ * line. a failed edit changes nothing.
+ */
+
+typedef struct ini_writer ini_writer;
+
+/*
+ * ini_writer_open
+ *
+ * in    : path of the ini file
+ * return: a writer, or NULL if the file can't be read or doesn't
+ *         parse
+ */
+
+ini_writer *
+ini_writer_open(
+	const char *path
+);
+
+int
+ini_writer_set(
+	ini_writer *w,
+	const char *section,
+	const char *key,
+	const char *value
+);
+
+int
+ini_writer_add(
+	ini_writer *w,
+	const char *section,
+	const char *key,
+	const char *value
+);
+
+/* removing a key that isn't there is not an error. */
+
+int
+ini_writer_delete(
+	ini_writer *w,
+	const char *section,
+	const char *key
+);
+
+/* lines the batch so far adds, removes, or changes. */
+
+size_t
+ini_writer_changes(
+	const ini_writer *w
+);
+
+/*
+ * ini_writer_write
+ *
+ * write the edited file to an open descriptor. the batch stays
+ * pending.
+ *
+ * return: EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+int
+ini_writer_write(
+	ini_writer *w,
+	int fd
+);
+
+/*
+ * ini_writer_commit
+ *
+ * replace the file with the edited one and start a new batch on it.
+ * if the replace fails the file is untouched and the batch is still
+ * pending. the next edit or write rereads the file, and if that
+ * fails it and everything after it fails.
+ *
+ * return: EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+int
+ini_writer_commit(
+	ini_writer *w
+);
+
+void
+ini_writer_close(
+	ini_writer *w
+);
+
+#endif /* INIWRITE_H */
+
+/* iniwrite.h ends here */
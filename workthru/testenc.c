@@ -0,0 +1,279 @@
+/* testenc.c -- exercise byte order marks, UTF-16 input, and UTF-8 validation */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "inienc.h"
+#include "iniparser.h"
+
+bool
+cb_ini_parser(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	printf("'%s':'%s':'%s'\n", section, key, value);
+	return false;
+}
+
+long
+read_file(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	size_t got = fread(buffer, 1, buflen, handle);
+	if (got == 0 && ferror((FILE *)handle))
+		return -1;
+	return got;
+}
+
+/* a block of memory as reader input. */
+
+typedef struct memory {
+	const char *text;
+	size_t len;
+	size_t pos;
+} memory;
+
+long
+read_memory(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	memory *m = handle;
+	size_t n = m->len - m->pos < buflen ? m->len - m->pos : buflen;
+	memcpy(buffer, m->text + m->pos, n);
+	m->pos += n;
+	return n;
+}
+
+const char *encodings[] = { "UTF-8", "UTF-8 with BOM", "UTF-16LE", "UTF-16BE" };
+
+/*
+ * decode_all
+ *
+ * read everything through a decoder in blocks of 'step' bytes.
+ *
+ * out   : the UTF-8, allocated, or NULL on an error
+ * out   : its length
+ * return: the decoder's error or NULL
+ */
+
+const char *
+decode_all(
+	FILE *file,
+	int mode,
+	size_t step,
+	char **text,
+	size_t *len,
+	int *encoding
+) {
+	static char why[128];
+	ini_decoder *d = ini_decoder_open(read_file, file, mode);
+	size_t cap = 4096;
+	*text = malloc(cap);
+	*len = 0;
+	long got;
+	do {
+		if (cap - *len < step) {
+			cap = cap * 2 + step;
+			*text = realloc(*text, cap);
+		}
+		got = ini_decoder_read(d, *text + *len, step);
+		if (got > 0)
+			*len += got;
+	} while (got > 0);
+	*encoding = ini_decoder_encoding(d);
+	const char *error = NULL;
+	if (got < 0) {
+		snprintf(why, sizeof(why), "%s", ini_decoder_error(d));
+		error = why;
+		free(*text);
+		*text = NULL;
+	}
+	ini_decoder_close(d);
+	return error;
+}
+
+double
+now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * bench
+ *
+ * time the decoder over generated text in memory, read in the
+ * parser's 64K blocks: UTF-8 passed through, UTF-8 validated, and
+ * UTF-16LE transcoded. the text is mostly ASCII with a multibyte
+ * value every so often, like a real ini file.
+ */
+
+#define BENCH_BLOCK 65536
+
+void
+bench(
+	size_t megabytes
+) {
+	size_t len = megabytes << 20;
+	char *text = malloc(len);
+	size_t pos = 0;
+	unsigned n = 0;
+	while (pos < len) {
+		char line[128];
+		int k = snprintf(line, sizeof(line), (n % 8) == 0
+				? "name_%u = caf\xc3\xa9 \xe2\x82\xac\n" : "key_%u = value %u\n",
+				n, n * 7);
+		if ((size_t)k > len - pos)
+			k = len - pos;
+		memcpy(text + pos, line, k);
+		pos += k;
+		n += 1;
+	}
+	/* don't end in the middle of a character. */
+	while (pos > 0 && ((unsigned char)text[pos-1] & 0xc0) == 0x80)
+		text[--pos] = '\n';
+	if (pos > 0 && (unsigned char)text[pos-1] >= 0xc0)
+		text[pos-1] = '\n';
+
+	/* the same text as UTF-16LE, through the decoder itself. */
+	char *wide = malloc(len * 2 + 2);
+	size_t wlen = 2;
+	wide[0] = (char)0xff;
+	wide[1] = (char)0xfe;
+	for (size_t i = 0; i < len; ) {
+		unsigned char c = text[i];
+		unsigned cp = c;
+		int extra = c < 0x80 ? 0 : c < 0xe0 ? 1 : c < 0xf0 ? 2 : 3;
+		if (extra)
+			cp = c & (0x3f >> extra);
+		for (int j = 1; j <= extra; j++)
+			cp = cp << 6 | (text[i+j] & 0x3f);
+		i += extra + 1;
+		wide[wlen++] = cp & 0xff;
+		wide[wlen++] = cp >> 8;
+	}
+
+	char *block = malloc(BENCH_BLOCK);
+	struct {
+		const char *name;
+		const char *input;
+		size_t len;
+		int mode;
+	} runs[] = {
+		{ "utf-8 detect  ", text, len, INI_ENC_DETECT },
+		{ "utf-8 validate", text, len, INI_ENC_VALIDATE },
+		{ "utf-16 to utf-8", wide, wlen, INI_ENC_DETECT },
+	};
+	for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+		double best = 0;
+		size_t out = 0;
+		for (int t = 0; t < 3; t++) {
+			memory m = { runs[r].input, runs[r].len, 0 };
+			ini_decoder *d = ini_decoder_open(read_memory, &m, runs[r].mode);
+			double start = now();
+			long got;
+			out = 0;
+			while ((got = ini_decoder_read(d, block, BENCH_BLOCK)) > 0)
+				out += got;
+			double elapsed = now() - start;
+			if (got < 0)
+				printf("%s: %s\n", runs[r].name, ini_decoder_error(d));
+			ini_decoder_close(d);
+			if (t == 0 || elapsed < best)
+				best = elapsed;
+		}
+		printf("%s %6zu MB in, %6zu MB out, %7.2f GB/s\n", runs[r].name,
+			runs[r].len >> 20, out >> 20,
+			runs[r].len / (best > 0 ? best : 1e-9) / 1e9);
+	}
+	free(block);
+	free(wide);
+	free(text);
+}
+
+/*
+ * test driver.
+ *
+ * testenc [validate] file...
+ * testenc bench [megabytes]
+ *
+ * for each file report the encoding found, check that reading the
+ * decoder a byte at a time gives what reading it in big blocks
+ * does, and parse it with ini_options.encoding set.
+ *
+ * bench reports the decoder's throughput over generated text.
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 64);
+		return EXIT_SUCCESS;
+	}
+	int mode = INI_ENC_DETECT;
+	int first = 1;
+	if (argc > 1 && strcmp(argv[1], "validate") == 0) {
+		mode = INI_ENC_VALIDATE;
+		first = 2;
+	}
+	if (argc <= first) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+
+	int status = EXIT_SUCCESS;
+	for (int i = first; i < argc; i++) {
+		FILE *file = fopen(argv[i], "rb");
+		if (!file) {
+			printf("error coult not open file %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		char *big;
+		char *small;
+		size_t big_len;
+		size_t small_len;
+		int encoding;
+		const char *error = decode_all(file, mode, 65536, &big, &big_len,
+				&encoding);
+		printf("%s: %s", argv[i], encodings[encoding]);
+		if (error != NULL)
+			printf(", %s\n", error);
+		else {
+			rewind(file);
+			decode_all(file, mode, 1, &small, &small_len, &encoding);
+			bool same = small != NULL && small_len == big_len
+				&& memcmp(small, big, big_len) == 0;
+			printf(", %zu bytes of UTF-8%s\n", big_len,
+				same ? "" : ", BYTE AT A TIME DIFFERS");
+			if (!same)
+				status = EXIT_FAILURE;
+			free(small);
+			free(big);
+		}
+
+		rewind(file);
+		ini_options options = { 0 };
+		options.encoding = mode;
+		int parse_status = parse_ini_ex(file, NULL, cb_ini_parser, &options);
+		fclose(file);
+		if (parse_status != EXIT_SUCCESS)
+			printf("%s: parse failed\n", argv[i]);
+		printf("\n");
+	}
+	return status;
+}
+
+/* testenc.c ends here */
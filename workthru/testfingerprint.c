@@ -0,0 +1,123 @@
+/* testfingerprint.c -- exercise the parse fingerprint */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inihash.h"
+#include "iniparser.h"
+
+bool
+cb_quiet(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	return false;
+}
+
+/*
+ * check_vectors
+ *
+ * ini_hash_fast against published xxh64 results, short and long
+ * inputs, with and without a seed.
+ *
+ * return: the number that differ
+ */
+
+int
+check_vectors(void) {
+	const char *digits = "1234567890123456789012345678901234567890"
+		"1234567890123456789012345678901234567890";
+	struct {
+		const char *bytes;
+		size_t len;
+		uint64_t seed;
+		uint64_t hash;
+	} vectors[] = {
+		{ "", 0, 0, 0xef46db3751d8e999ULL },
+		{ "a", 1, 0, 0xd24ec4f1a98c6e5bULL },
+		{ "abc", 3, 0, 0x44bc2cf5ad770999ULL },
+		{ "abc", 3, 1, 0xbea9ca8199328908ULL },
+		{ "message digest", 14, 0, 0x066ed728fceeb3beULL },
+		{ "abcdefghijklmnopqrstuvwxyz", 26, 0, 0xcfe1f278fa89835cULL },
+		{ digits, 80, 0, 0xe04a477f19ee145dULL },
+		{ digits, 80, 0x9e3779b97f4a7c15ULL, 0xc8ff17e801741950ULL },
+		{ "server\0port\0", 12, 42, 0xcfbacae1d2f5dca9ULL },
+	};
+	int wrong = 0;
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		uint64_t got = ini_hash_fast(vectors[i].bytes, vectors[i].len,
+				vectors[i].seed);
+		if (got != vectors[i].hash) {
+			printf("xxh64 vector %zu: %016" PRIx64 ", expected %016" PRIx64 "\n",
+				i, got, vectors[i].hash);
+			wrong += 1;
+		}
+	}
+	printf("xxh64 vectors: %d of %zu wrong\n", wrong,
+		sizeof(vectors) / sizeof(vectors[0]));
+	return wrong;
+}
+
+/*
+ * test driver.
+ *
+ * testfingerprint vectors
+ * testfingerprint file [file...]
+ *
+ * print each file's fingerprints and whether they match the first
+ * file's. with the fixtures:
+ *
+ *   tests/test_fingerprint.ini           the reference
+ *   tests/test_fingerprint_same.ini      comments and spacing differ,
+ *                                        both match
+ *   tests/test_fingerprint_reordered.ini pairs and sections moved,
+ *                                        only unordered matches
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	if (strcmp(argv[1], "vectors") == 0)
+		return check_vectors() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	ini_fingerprint first = { 0 };
+	for (int i = 1; i < argc; i++) {
+		FILE *file = fopen(argv[i], "r");
+		if (!file) {
+			printf("error coult not open file %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+		ini_fingerprint fp;
+		ini_options options = { 0 };
+		options.fingerprint = &fp;
+		int parse_status = parse_ini_ex(file, NULL, cb_quiet, &options);
+		fclose(file);
+		if (parse_status == EXIT_FAILURE) {
+			printf("%s: parse failed, check input file\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+		if (i == 1)
+			first = fp;
+		printf("%s\n  ordered   %016" PRIx64 " %s\n"
+			"  unordered %016" PRIx64 " %s\n  pairs     %zu\n",
+			argv[i],
+			fp.ordered, fp.ordered == first.ordered
+				&& fp.pairs == first.pairs ? "same" : "differs",
+			fp.unordered, fp.unordered == first.unordered
+				&& fp.pairs == first.pairs ? "same" : "differs",
+			fp.pairs);
+	}
+	return EXIT_SUCCESS;
+}
+
+/* testfingerprint.c ends here */
@@ -0,0 +1,99 @@
+/* testfold.c -- exercise case folded parsing and index lookups */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "inifold.h"
+#include "iniindex.h"
+#include "iniparser.h"
+
+bool
+cb_ini_parser(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	printf("'%s':'%s':'%s'\n", section, key, value);
+	return false;
+}
+
+/*
+ * test driver.
+ *
+ * testfold file [ascii|unicode] [section:key...]
+ *
+ * parse the file with names folded and the last of any duplicate
+ * kept, then build a folded index and list it with the spelling
+ * from the file. each section:key given is looked up in the index.
+ *
+ *   testfold tests/test_fold.ini unicode NETWORK:timeout Straße:Größe
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	int fold = INI_FOLD_ASCII;
+	if (argc > 2 && strcmp(argv[2], "unicode") == 0)
+		fold = INI_FOLD_UNICODE;
+
+	FILE *file = fopen(argv[1], "r");
+	if (!file) {
+		printf("error coult not open file %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	printf("parse, folded, last duplicate kept\n");
+	ini_options options = { 0 };
+	options.fold = fold;
+	options.duplicates = INI_DUP_LAST;
+	int parse_status = parse_ini_ex(file, NULL, cb_ini_parser, &options);
+	if (parse_status != EXIT_SUCCESS) {
+		fclose(file);
+		printf("parse failed, check input file\n");
+		return EXIT_FAILURE;
+	}
+
+	rewind(file);
+	ini_index *idx = ini_index_build_ex(file, fold);
+	fclose(file);
+	if (idx == NULL) {
+		printf("index build failed, check input file\n");
+		return EXIT_FAILURE;
+	}
+	printf("\nfolded index, as spelled\n");
+	ini_section_range sections = ini_index_sections(idx);
+	for (size_t i = 0; i < sections.count; i++) {
+		const ini_section *s = &sections.first[i];
+		printf("section '%s' (%zu pairs)\n", s->name, s->count);
+		for (size_t j = 0; j < s->count; j++)
+			printf("  '%s':'%s':'%s'\n", s->first[j].section,
+				s->first[j].key, s->first[j].value);
+	}
+
+	printf("\nlookups\n");
+	for (int i = 3; i < argc; i++) {
+		char *colon = strchr(argv[i], ':');
+		if (colon == NULL)
+			continue;
+		*colon = '\0';
+		const ini_entry *e = ini_index_get(idx, argv[i], colon + 1);
+		if (e == NULL)
+			printf("%s:%s not found\n", argv[i], colon + 1);
+		else
+			printf("%s:%s = '%s' from [%s] %s\n", argv[i], colon + 1,
+				e->value, e->section, e->key);
+	}
+
+	ini_index_free(idx);
+	return EXIT_SUCCESS;
+}
+
+/* testfold.c ends here */
@@ -0,0 +1,83 @@
+/* testindex.c -- exercise the ordered ini index */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iniindex.h"
+
+/*
+ * visitors for the glob queries. they print what they are given and
+ * never ask for the walk to stop.
+ */
+
+const char *key_pattern = NULL;
+
+bool
+print_entry(
+	const ini_entry *entry,
+	void *ctx
+) {
+	printf("  key:value  '%s':'%s'\n", entry->key, entry->value);
+	return false;
+}
+
+bool
+print_section(
+	const ini_section *section,
+	void *ctx
+) {
+	printf("\nsection    '%s' (%zu pairs)\n", section->name, section->count);
+	if (key_pattern != NULL)
+		ini_index_key_glob(ctx, section->name, key_pattern,
+			print_entry, NULL);
+	return false;
+}
+
+/*
+ * test driver.
+ *
+ * testindex file                  list the index in order
+ * testindex file sec-glob         list matching sections
+ * testindex file sec-glob key-glob  and their matching keys
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	FILE *file = fopen(argv[1], "r");
+	if (!file) {
+		printf("error coult not open file %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	ini_index *idx = ini_index_build(file);
+	fclose(file);
+	if (idx == NULL) {
+		printf("index build failed, check input file\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc < 3) {
+		ini_range all = ini_index_entries(idx);
+		for (size_t i = 0; i < all.count; i++)
+			printf("'%s':'%s':'%s'\n", all.first[i].section,
+				all.first[i].key, all.first[i].value);
+	} else {
+		key_pattern = argc > 3 ? argv[3] : NULL;
+		size_t n = ini_index_section_glob(idx, argv[2],
+				print_section, idx);
+		printf("\n%zu sections matched\n", n);
+	}
+
+	ini_index_free(idx);
+	return EXIT_SUCCESS;
+}
+
+/* testindex.c ends here */
@@ -0,0 +1,98 @@
+/* testinterp.c -- exercise ${section:key} interpolation */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iniindex.h"
+#include "iniinterp.h"
+
+/*
+ * load
+ *
+ * open and index one ini file, reporting any failure.
+ */
+
+ini_index *
+load(
+	const char *name
+) {
+	FILE *file = fopen(name, "r");
+	if (!file) {
+		printf("error coult not open file %s\n", name);
+		return NULL;
+	}
+	ini_index *idx = ini_index_build(file);
+	fclose(file);
+	if (idx == NULL)
+		printf("index build failed, check input file %s\n", name);
+	return idx;
+}
+
+/*
+ * expand_all
+ *
+ * expand every key of the index in order and print the result.
+ */
+
+void
+expand_all(
+	ini_interp *interp,
+	const ini_index *idx
+) {
+	ini_range all = ini_index_entries(idx);
+	for (size_t i = 0; i < all.count; i++) {
+		const ini_entry *e = &all.first[i];
+		int status;
+		const char *v = ini_interp_get(interp, e->section, e->key, &status);
+		if (v != NULL)
+			printf("'%s':'%s'  '%s'\n", e->section, e->key, v);
+		else
+			printf("'%s':'%s'  error %d %s\n", e->section, e->key,
+				status, ini_interp_error(interp));
+	}
+}
+
+/*
+ * test driver.
+ *
+ * testinterp file          expand every key
+ * testinterp file reload   expand, reload from a second file, and
+ *                          expand again
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	ini_index *idx = load(argv[1]);
+	if (idx == NULL)
+		return EXIT_FAILURE;
+	ini_interp *interp = ini_interp_create(idx);
+	if (interp == NULL)
+		return EXIT_FAILURE;
+	expand_all(interp, idx);
+
+	if (argc > 2) {
+		ini_index *next = load(argv[2]);
+		if (next == NULL)
+			return EXIT_FAILURE;
+		size_t discarded = ini_interp_reload(interp, next);
+		ini_index_free(idx);
+		idx = next;
+		printf("\nreloaded, %zu cached values discarded\n\n", discarded);
+		expand_all(interp, idx);
+	}
+
+	ini_interp_free(interp);
+	ini_index_free(idx);
+	return EXIT_SUCCESS;
+}
+
+/* testinterp.c ends here */
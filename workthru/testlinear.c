@@ -0,0 +1,371 @@
+/* testlinear.c -- check that hostile input parses in linear time */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iniparser.h"
+
+/*
+ * an adversarial corpus, generated in memory. each case repeats one
+ * kind of line that is cheap to write and has been, or could be,
+ * expensive to parse:
+ *
+ *   benign        ordinary sections and pairs, the yardstick
+ *   long values   values of 256K, far past INI_VAL_MAXLEN
+ *   long keys     keys of 256K before the =
+ *   long comments comment lines of 256K
+ *   long headers  [section] names of 256K
+ *   empty headers millions of "[ ]"
+ *   lone cr       pairs ended by \r alone, so one endless line
+ *   whitespace    blank lines of 4K spaces and tabs, and pairs with
+ *                 4K of spaces around the =
+ *   tiny pairs    millions of "k=" with empty values
+ *
+ * each case is parsed at two sizes. time must grow no more than
+ * LINEAR_SLACK times as fast as size, and bytes per second must be
+ * within SLOWEST_FACTOR of the benign case. then the resource limits
+ * are checked to stop a parse early.
+ *
+ * tiny pairs is the slowest case by design, three bytes of input
+ * cost a whole trip through the parser and the callback.
+ *
+ * cases that run at memory speed, far faster than the benign case,
+ * slow down when the larger size no longer fits in cache. that
+ * isn't the parser, so growth is only held against a case that is
+ * slower than benign at the larger size.
+ */
+
+#define LINEAR_SLACK   1.5
+#define SLOWEST_FACTOR 10.0
+#define RUNS           3
+
+typedef struct corpus {
+	char *text;
+	size_t len;
+	size_t cap;
+} corpus;
+
+void
+put(
+	corpus *c,
+	const char *s,
+	size_t n
+) {
+	if (c->len + n > c->cap) {
+		while (c->len + n > c->cap)
+			c->cap = c->cap ? c->cap * 2 : 65536;
+		c->text = realloc(c->text, c->cap);
+		if (c->text == NULL) {
+			printf("error out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(c->text + c->len, s, n);
+	c->len += n;
+}
+
+void
+puts_c(
+	corpus *c,
+	const char *s
+) {
+	put(c, s, strlen(s));
+}
+
+void
+put_run(
+	corpus *c,
+	const char *pattern,
+	size_t n
+) {
+	size_t plen = strlen(pattern);
+	for (size_t i = 0; i < n; i++)
+		put(c, pattern + i % plen, 1);
+}
+
+#define RUN 262144
+
+void
+gen_benign(corpus *c, size_t size) {
+	char line[80];
+	for (long i = 0; c->len < size; i++) {
+		if (i % 20 == 0) {
+			snprintf(line, sizeof(line), "[section.%ld]\n", i / 20);
+			puts_c(c, line);
+		}
+		snprintf(line, sizeof(line), "key%ld = value %ld some/path/here\n",
+			i % 20, i * 7919 % 1000003);
+		puts_c(c, line);
+	}
+}
+
+void
+gen_long_values(corpus *c, size_t size) {
+	while (c->len < size) {
+		puts_c(c, "key = ");
+		put_run(c, "value ", RUN);
+		puts_c(c, "\n");
+	}
+}
+
+void
+gen_long_keys(corpus *c, size_t size) {
+	while (c->len < size) {
+		put_run(c, "k", RUN);
+		puts_c(c, " = v\n");
+	}
+}
+
+void
+gen_long_comments(corpus *c, size_t size) {
+	while (c->len < size) {
+		puts_c(c, "; ");
+		put_run(c, "comment ", RUN);
+		puts_c(c, "\n");
+	}
+}
+
+void
+gen_long_headers(corpus *c, size_t size) {
+	while (c->len < size) {
+		puts_c(c, "[");
+		put_run(c, "s", RUN);
+		puts_c(c, "]\nk = v\n");
+	}
+}
+
+void
+gen_empty_headers(corpus *c, size_t size) {
+	while (c->len < size)
+		puts_c(c, "[ ]\n");
+}
+
+void
+gen_lone_cr(corpus *c, size_t size) {
+	while (c->len < size)
+		puts_c(c, "key = value\r");
+	puts_c(c, "\n");
+}
+
+void
+gen_whitespace(corpus *c, size_t size) {
+	while (c->len < size) {
+		put_run(c, " \t  ", 4096);
+		puts_c(c, "\nk");
+		put_run(c, " ", 4096);
+		puts_c(c, "=");
+		put_run(c, " ", 4096);
+		puts_c(c, "v\n");
+	}
+}
+
+void
+gen_tiny_pairs(corpus *c, size_t size) {
+	while (c->len < size)
+		puts_c(c, "k=\n");
+}
+
+typedef struct gen_case {
+	const char *name;
+	void (*gen)(corpus *c, size_t size);
+} gen_case;
+
+gen_case cases[] = {
+	{ "benign", gen_benign },
+	{ "long values", gen_long_values },
+	{ "long keys", gen_long_keys },
+	{ "long comments", gen_long_comments },
+	{ "long headers", gen_long_headers },
+	{ "empty headers", gen_empty_headers },
+	{ "lone cr", gen_lone_cr },
+	{ "whitespace", gen_whitespace },
+	{ "tiny pairs", gen_tiny_pairs },
+};
+
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+/*
+ * a reader over a block of memory, counting what it hands out.
+ */
+
+typedef struct memory {
+	const char *text;
+	size_t len;
+	size_t pos;
+} memory;
+
+long
+read_memory(
+	void *handle,
+	char *buffer,
+	size_t buflen
+) {
+	memory *m = handle;
+	size_t n = m->len - m->pos < buflen ? m->len - m->pos : buflen;
+	memcpy(buffer, m->text + m->pos, n);
+	m->pos += n;
+	return n;
+}
+
+bool
+cb_count(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	*(size_t *)ctx += 1;
+	return false;
+}
+
+double
+now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * time_parse
+ *
+ * best of RUNS parses of the corpus.
+ *
+ * return: seconds
+ */
+
+double
+time_parse(
+	const corpus *c
+) {
+	double best = 0;
+	for (int r = 0; r < RUNS; r++) {
+		memory m = { c->text, c->len, 0 };
+		size_t pairs = 0;
+		double start = now();
+		parse_ini_reader(read_memory, &m, &pairs, cb_count, NULL);
+		double elapsed = now() - start;
+		if (r == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best > 1e-6 ? best : 1e-6;
+}
+
+/*
+ * check_limit
+ *
+ * parse with the options and expect INI_LIMIT_EXCEEDED after reading
+ * no more than 'most' bytes.
+ */
+
+bool
+check_limit(
+	const char *name,
+	const corpus *c,
+	const ini_options *options,
+	size_t most
+) {
+	memory m = { c->text, c->len, 0 };
+	size_t pairs = 0;
+	int status = parse_ini_reader(read_memory, &m, &pairs, cb_count, options);
+	bool ok = status == INI_LIMIT_EXCEEDED && m.pos <= most;
+	printf("%-16s returned %d after %zu of %zu bytes, %zu pairs  %s\n",
+		name, status, m.pos, c->len, pairs, ok ? "ok" : "FAILED");
+	return ok;
+}
+
+/*
+ * test driver.
+ *
+ * testlinear [megabytes] [directory]
+ *
+ * megabytes is the smaller size of each case, 8 by default. if a
+ * directory is given, the larger corpus of each case is also written
+ * there, to try on other parsers.
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	size_t size = (argc > 1 ? atoi(argv[1]) : 8) * 1048576L;
+	if (size == 0)
+		size = 8 * 1048576L;
+	bool passed = true;
+	double benign = 0;
+
+	printf("%-16s %10s %10s %8s %8s\n", "case", "MB/s", "MB/s x2",
+		"growth", "vs benign");
+	for (size_t i = 0; i < CASES; i++) {
+		corpus small = { 0 };
+		corpus large = { 0 };
+		cases[i].gen(&small, size);
+		cases[i].gen(&large, size * 2);
+		double rate = small.len / time_parse(&small) / 1e6;
+		double rate2 = large.len / time_parse(&large) / 1e6;
+		if (i == 0)
+			benign = rate;
+
+		/* growth is how much faster than size the time grew. */
+
+		double growth = rate / rate2;
+		double slower = benign / (rate < rate2 ? rate : rate2);
+		bool ok = (growth <= LINEAR_SLACK || rate2 >= benign)
+			&& slower <= SLOWEST_FACTOR;
+		printf("%-16s %10.1f %10.1f %8.2f %8.2f  %s\n", cases[i].name,
+			rate, rate2, growth, slower, ok ? "ok" : "FAILED");
+		passed = passed && ok;
+
+		if (argc > 2) {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/%s.ini", argv[2],
+				cases[i].name);
+			for (char *p = path + strlen(argv[2]); *p; p++)
+				if (*p == ' ')
+					*p = '_';
+			FILE *out = fopen(path, "wb");
+			if (out != NULL) {
+				fwrite(large.text, 1, large.len, out);
+				fclose(out);
+			}
+		}
+		free(small.text);
+		free(large.text);
+	}
+
+	/* the limits. a line is caught within one scan block of the
+	 * limit, the others on the expression that passes them. */
+
+	printf("\n");
+	corpus c = { 0 };
+	gen_long_values(&c, size);
+	ini_options options = { 0 };
+	options.max_line = 1000;
+	passed = check_limit("max_line", &c, &options, 1000 + 2 * 65536)
+		&& passed;
+	free(c.text);
+
+	c = (corpus){ 0 };
+	gen_empty_headers(&c, size);
+	options = (ini_options){ 0 };
+	options.max_sections = 1000;
+	passed = check_limit("max_sections", &c, &options, 4000 + 2 * 65536)
+		&& passed;
+	free(c.text);
+
+	c = (corpus){ 0 };
+	gen_tiny_pairs(&c, size);
+	options = (ini_options){ 0 };
+	options.max_pairs = 1000;
+	passed = check_limit("max_pairs", &c, &options, 3000 + 2 * 65536)
+		&& passed;
+	free(c.text);
+
+	printf("\n%s\n", passed ? "all passed" : "some FAILED");
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* testlinear.c ends here */
@@ -39,8 +39,18 @@ cb_ini_parser(
 	&& strcmp(value, "STOP") == 0;
 }
 
+/*
+ * duplicate policies by name, for the optional second argument.
+ */
+
+const char *policies[] = {
+	"all", "first", "last", "collect", "error", NULL
+};
+
 /*
  * test driver.
+ *
+ * testparser file [all|first|last|collect|error]
  */
 
 int
@@ -58,8 +68,20 @@ main(
 		printf("error coult not open file %s\n", argv[1]);
 		return EXIT_FAILURE;
 	}
+	ini_options options = { 0 };
+	if (argc > 2) {
+		int i = 0;
+		while (policies[i] != NULL && strcmp(policies[i], argv[2]) != 0)
+			i += 1;
+		if (policies[i] == NULL) {
+			printf("error unknown duplicate policy %s\n", argv[2]);
+			return EXIT_FAILURE;
+		}
+		options.duplicates = i;
+		options.separator = '|';
+	}
 	last_section[0] = '\0';
-	int parse_status = parse_ini(file, &bogus_ctx, cb_ini_parser);
+	int parse_status = parse_ini_ex(file, &bogus_ctx, cb_ini_parser, &options);
 	printf("\nparse complete, returned %d\n", parse_status);
 	if (parse_status == EXIT_FAILURE) {
 		printf("parse failed, check input file\n");
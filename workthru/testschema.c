@@ -0,0 +1,107 @@
+/* testschema.c -- exercise schema validation during the parse */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iniparser.h"
+#include "inischema.h"
+
+/*
+ * the schema for tests/test_schema.ini, its error-free twin
+ * tests/test_schema_good.ini, and tests/test_schema_reopen.ini.
+ *
+ * [server]  host string required, port int 1..65535 default 80,
+ *           debug bool default false
+ * [limits]  ratio float 0..1, name string length 1..8
+ * [extras]  anything goes
+ */
+
+ini_schema *
+build_schema(void) {
+	ini_schema *schema = ini_schema_create(false);
+	if (schema == NULL)
+		return NULL;
+	bool ok = ini_schema_key(schema, "server", "host", INI_TYPE_STRING,
+			INI_KEY_REQUIRED, 0, 0, NULL)
+		&& ini_schema_key(schema, "server", "port", INI_TYPE_INT,
+			INI_KEY_RANGE, 1, 65535, "80")
+		&& ini_schema_key(schema, "server", "debug", INI_TYPE_BOOL,
+			0, 0, 0, "false")
+		&& ini_schema_key(schema, "limits", "ratio", INI_TYPE_FLOAT,
+			INI_KEY_RANGE, 0, 1, NULL)
+		&& ini_schema_key(schema, "limits", "name", INI_TYPE_STRING,
+			INI_KEY_RANGE, 1, 8, "default")
+		&& ini_schema_section(schema, "extras", true);
+	if (!ok) {
+		ini_schema_free(schema);
+		return NULL;
+	}
+	return schema;
+}
+
+bool
+cb_ini_parser(
+	const char *section,
+	const char *key,
+	const char *value,
+	void *ctx
+) {
+	printf("'%s':'%s':'%s'\n", section, key, value);
+	return false;
+}
+
+void
+cb_schema_error(
+	long line,
+	long column,
+	const char *section,
+	const char *key,
+	const char *message,
+	void *ctx
+) {
+	printf("%ld:%ld: [%s] %s: %s\n", line, column, section,
+		key ? key : "", message);
+}
+
+/*
+ * test driver.
+ *
+ * testschema file
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	FILE *file = fopen(argv[1], "r");
+	if (!file) {
+		printf("error coult not open file %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	ini_schema *schema = build_schema();
+	if (schema == NULL) {
+		printf("error building schema\n");
+		return EXIT_FAILURE;
+	}
+	ini_options options = { 0 };
+	options.schema = schema;
+	options.schema_error = cb_schema_error;
+	int parse_status = parse_ini_ex(file, NULL, cb_ini_parser, &options);
+	fclose(file);
+	ini_schema_free(schema);
+	printf("\nparse complete, returned %d\n", parse_status);
+	if (parse_status == EXIT_FAILURE) {
+		printf("parse failed, check input file\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/* testschema.c ends here */
@@ -0,0 +1,165 @@
+/* teststore.c -- exercise the compact store and its footprint report */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "iniindex.h"
+#include "iniparser.h"
+#include "inistore.h"
+
+void
+print_footprint(
+	const ini_store *store
+) {
+	ini_footprint fp;
+	ini_store_footprint(store, &fp);
+	printf("pairs          %10zu\n", fp.pairs);
+	printf("section runs   %10zu\n", fp.sections);
+	printf("strings        %10zu, %zu inline, %zu distinct pooled\n",
+		fp.strings, fp.inlined, fp.pooled);
+	printf("text copied    %10zu bytes\n", fp.text_bytes);
+	printf("pool           %10zu bytes\n", fp.pool_bytes);
+	printf("records        %10zu bytes\n", fp.record_bytes);
+	printf("index          %10zu bytes\n", fp.index_bytes);
+	printf("total          %10zu bytes\n", fp.total_bytes);
+	printf("bytes per pair %10.1f\n", fp.bytes_per_pair);
+	printf("dedup ratio    %10.1f\n", fp.dedup_ratio);
+}
+
+/*
+ * bench
+ *
+ * a generated configuration of many hosts whose values mostly
+ * repeat, put in a store and an index. every lookup in the store is
+ * checked against the index, and the footprint is compared with
+ * copying each string out of the parse into its own allocation.
+ */
+
+void
+bench(
+	size_t hosts
+) {
+	ini_store *store = ini_store_create();
+	ini_index *idx = ini_index_create();
+	char section[32];
+	char value[64];
+	const char *regions[] = { "us-east-1", "us-west-2", "eu-central-1" };
+	for (size_t i = 0; i < hosts; i++) {
+		snprintf(section, sizeof(section), "host.%zu", i);
+		struct {
+			const char *key;
+			const char *value;
+		} pairs[] = {
+			{ "enabled", i % 10 ? "true" : "false" },
+			{ "port", "8080" },
+			{ "retries", "0" },
+			{ "region", regions[i % 3] },
+			{ "log_path", "/var/log/service/current.log" },
+			{ "upstream", "backend.internal.example.com" },
+			{ "address", value },
+		};
+		snprintf(value, sizeof(value), "10.%zu.%zu.%zu",
+			i >> 16 & 255, i >> 8 & 255, i & 255);
+		for (size_t j = 0; j < sizeof(pairs) / sizeof(pairs[0]); j++) {
+			ini_store_add(store, section, pairs[j].key, pairs[j].value);
+			ini_index_add(idx, section, pairs[j].key, pairs[j].value);
+		}
+	}
+	if (!ini_store_finish(store) || !ini_index_finish(idx)) {
+		printf("error building the store or index\n");
+		return;
+	}
+
+	size_t mismatches = 0;
+	ini_range all = ini_index_entries(idx);
+	for (size_t i = 0; i < all.count; i++) {
+		const ini_entry *e = ini_index_get(idx, all.first[i].section,
+				all.first[i].key);
+		const char *v = ini_store_get(store, all.first[i].section,
+				all.first[i].key);
+		if (v == NULL || strcmp(v, e->value) != 0)
+			mismatches += 1;
+	}
+	if (ini_store_get(store, "host.0", "missing") != NULL)
+		mismatches += 1;
+	printf("%zu hosts, %zu lookups checked against the index, %zu wrong\n\n",
+		hosts, all.count, mismatches);
+
+	print_footprint(store);
+
+	/* three separate copies and three pointers per pair, before
+	 * any allocator overhead. */
+	ini_footprint fp;
+	ini_store_footprint(store, &fp);
+	size_t copied = fp.text_bytes + fp.pairs * 3 * sizeof(char *);
+	printf("\ncopying each string out of the parse would take %zu bytes,\n"
+		"%.1f per pair, %.1f times the store\n", copied,
+		(double)copied / fp.pairs, (double)copied / fp.total_bytes);
+
+	ini_index_free(idx);
+	ini_store_free(store);
+}
+
+/*
+ * test driver.
+ *
+ * teststore file [section:key...]
+ * teststore bench [hosts]
+ *
+ * list the pairs of the file from a store in file order, look up
+ * each section:key given, and report the footprint.
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 100000);
+		return EXIT_SUCCESS;
+	}
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	FILE *file = fopen(argv[1], "r");
+	if (!file) {
+		printf("error coult not open file %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	ini_store *store = ini_store_build(file);
+	fclose(file);
+	if (store == NULL) {
+		printf("store build failed, check input file\n");
+		return EXIT_FAILURE;
+	}
+
+	const char *section;
+	const char *key;
+	const char *value;
+	for (size_t i = 0; ini_store_pair(store, i, &section, &key, &value); i++)
+		printf("'%s':'%s':'%s'\n", section, key, value);
+
+	printf("\nlookups\n");
+	for (int i = 2; i < argc; i++) {
+		char *colon = strchr(argv[i], ':');
+		if (colon == NULL)
+			continue;
+		*colon = '\0';
+		value = ini_store_get(store, argv[i], colon + 1);
+		if (value == NULL)
+			printf("%s:%s not found\n", argv[i], colon + 1);
+		else
+			printf("%s:%s = '%s'\n", argv[i], colon + 1, value);
+	}
+
+	printf("\nfootprint\n");
+	print_footprint(store);
+	ini_store_free(store);
+	return EXIT_SUCCESS;
+}
+
+/* teststore.c ends here */
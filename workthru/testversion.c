@@ -0,0 +1,207 @@
+/* testversion.c -- exercise config versions, reload, and rollback */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "iniparser.h"
+#include "iniversion.h"
+
+double
+now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct listing {
+	const ini_version *previous;
+} listing;
+
+/* print a section, marking whether it is the previous version's. */
+
+bool
+print_section(
+	const ini_vsection *s,
+	void *user_data
+) {
+	listing *l = user_data;
+	const char *mark = "new";
+	if (l->previous != NULL) {
+		const ini_vsection *old = ini_version_section(l->previous,
+				ini_vsection_name(s));
+		if (old == s)
+			mark = "shared";
+		else if (old != NULL)
+			mark = "changed";
+	}
+	printf("[%s] %s\n", ini_vsection_name(s), mark);
+	const char *key;
+	const char *value;
+	for (size_t i = 0; ini_vsection_pair(s, i, &key, &value); i++)
+		printf("  '%s':'%s'\n", key, value);
+	return false;
+}
+
+void
+print_version(
+	const ini_version *v,
+	const ini_version *previous
+) {
+	listing l = { previous };
+	printf("version %zu, %zu sections\n", ini_version_number(v),
+		ini_version_sections(v));
+	ini_version_walk(v, print_section, &l);
+}
+
+/*
+ * bench
+ *
+ * a version of many sections, then a reload that changes one
+ * section in every thousand and drops and adds one. the derive is
+ * timed against a derive from nothing, which is what keeping a
+ * whole second copy costs, and the rollback is checked.
+ */
+
+void
+write_config(
+	FILE *f,
+	size_t sections,
+	int change
+) {
+	for (size_t i = 0; i < sections; i++) {
+		if (change && i == 7)
+			continue;
+		fprintf(f, "[service.%zu]\n", i);
+		fprintf(f, "host = svc%zu.internal.example.com\n", i);
+		fprintf(f, "port = %zu\n", 8000 + i % 1000);
+		fprintf(f, "enabled = %s\n",
+			change && i % 1000 == 3 ? "false" : "true");
+		fprintf(f, "timeout = 30\n\n");
+	}
+	if (change)
+		fprintf(f, "[service.new]\nhost = new.internal.example.com\n");
+}
+
+void
+bench(
+	size_t sections
+) {
+	FILE *first = tmpfile();
+	FILE *second = tmpfile();
+	if (first == NULL || second == NULL) {
+		printf("error could not create temporary files\n");
+		return;
+	}
+	write_config(first, sections, 0);
+	write_config(second, sections, 1);
+
+	ini_history *h = ini_history_create(4);
+	ini_derive_stats stats;
+	rewind(first);
+	double t0 = now();
+	ini_history_reload(h, first, &stats);
+	double t1 = now();
+	printf("load     %zu sections built in %.1f ms\n", stats.built,
+		(t1 - t0) * 1e3);
+
+	rewind(second);
+	t0 = now();
+	const ini_version *v = ini_history_reload(h, second, &stats);
+	t1 = now();
+	if (v == NULL) {
+		printf("error reload failed\n");
+		ini_history_free(h);
+		fclose(first);
+		fclose(second);
+		return;
+	}
+	printf("reload   %zu sections, %zu shared, %zu built, %zu removed"
+		" in %.1f ms\n", stats.sections, stats.shared, stats.built,
+		stats.removed, (t1 - t0) * 1e3);
+
+	rewind(second);
+	t0 = now();
+	ini_version *copy = ini_version_derive(NULL, second, 0, &stats);
+	t1 = now();
+	printf("full     %zu sections built in %.1f ms\n", stats.built,
+		(t1 - t0) * 1e3);
+	ini_version_release(copy);
+
+	t0 = now();
+	bool rolled = ini_history_rollback(h);
+	t1 = now();
+	const ini_version *back = ini_history_current(h);
+	printf("rollback %s to version %zu in %.3f ms, service.7:host = %s,"
+		" service.3:enabled = %s\n", rolled ? "ok" : "failed",
+		ini_version_number(back), (t1 - t0) * 1e3,
+		ini_version_get(back, "service.7", "host"),
+		ini_version_get(back, "service.3", "enabled"));
+
+	ini_history_free(h);
+	fclose(first);
+	fclose(second);
+}
+
+/*
+ * test driver.
+ *
+ * testversion file...
+ * testversion bench [sections]
+ *
+ * reload each file in turn into a history, listing each version
+ * with its sections marked shared, changed, or new, then roll back
+ * through the history to the first version kept.
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 100000);
+		return EXIT_SUCCESS;
+	}
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	ini_history *h = ini_history_create(3);
+	if (h == NULL)
+		return EXIT_FAILURE;
+	for (int i = 1; i < argc; i++) {
+		FILE *file = fopen(argv[i], "r");
+		if (!file) {
+			printf("error coult not open file %s\n", argv[i]);
+			ini_history_free(h);
+			return EXIT_FAILURE;
+		}
+		const ini_version *previous = ini_history_current(h);
+		ini_derive_stats stats;
+		const ini_version *v = ini_history_reload(h, file, &stats);
+		fclose(file);
+		if (v == NULL) {
+			printf("reload of %s failed, keeping version %zu\n\n",
+				argv[i], previous ? ini_version_number(previous) : 0);
+			continue;
+		}
+		printf("%s: %zu shared, %zu built, %zu removed\n", argv[i],
+			stats.shared, stats.built, stats.removed);
+		print_version(v, previous);
+		printf("\n");
+	}
+
+	while (ini_history_rollback(h)) {
+		const ini_version *v = ini_history_current(h);
+		printf("rolled back to version %zu, %zu sections\n",
+			ini_version_number(v), ini_version_sections(v));
+	}
+	printf("versions held %zu\n", ini_history_count(h));
+	ini_history_free(h);
+	return EXIT_SUCCESS;
+}
+
+/* testversion.c ends here */
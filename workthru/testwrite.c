@@ -0,0 +1,180 @@
+/* testwrite.c -- exercise minimal edits to an ini file */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "iniparser.h"
+#include "iniwrite.h"
+
+/*
+ * apply_edit
+ *
+ * one edit from the command line:
+ *
+ *   section:key=value    set
+ *   +section:key=value   add
+ *   -section:key         delete
+ *
+ * the section is everything before the first ':', so a section
+ * name can't hold one here. use "" for pairs before any header,
+ * as in :key=value.
+ */
+
+int
+apply_edit(
+	ini_writer *w,
+	char *edit
+) {
+	char op = edit[0];
+	if (op == '+' || op == '-')
+		edit += 1;
+	char *colon = strchr(edit, ':');
+	if (colon == NULL)
+		return EXIT_FAILURE;
+	*colon = '\0';
+	char *key = colon + 1;
+	if (op == '-')
+		return ini_writer_delete(w, edit, key);
+	char *equals = strchr(key, '=');
+	if (equals == NULL)
+		return EXIT_FAILURE;
+	*equals = '\0';
+	if (op == '+')
+		return ini_writer_add(w, edit, key, equals + 1);
+	return ini_writer_set(w, edit, key, equals + 1);
+}
+
+double
+now(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * bench
+ *
+ * write a file of many sections, flip a flag in one section of
+ * every hundred and commit, and compare that with writing the
+ * whole file out again with fprintf, which loses its comments.
+ */
+
+#define BENCH_FILE "testwrite_bench.ini"
+
+void
+bench(
+	size_t sections
+) {
+	FILE *f = fopen(BENCH_FILE, "w");
+	if (f == NULL) {
+		printf("error could not create %s\n", BENCH_FILE);
+		return;
+	}
+	for (size_t i = 0; i < sections; i++) {
+		fprintf(f, "# host %zu\n[host_%zu]\n", i, i);
+		fprintf(f, "address = 10.%zu.%zu.%zu\n", i >> 16 & 255, i >> 8 & 255, i & 255);
+		fprintf(f, "enabled = true\nport = 8080\n; tuning\ntimeout = 30\n\n");
+	}
+	fclose(f);
+
+	double start = now();
+	ini_writer *w = ini_writer_open(BENCH_FILE);
+	double opened = now();
+	char name[32];
+	for (size_t i = 0; i < sections; i += 100) {
+		snprintf(name, sizeof(name), "host_%zu", i);
+		ini_writer_set(w, name, "enabled", "false");
+	}
+	size_t changes = ini_writer_changes(w);
+	double edited = now();
+	int status = w != NULL ? ini_writer_commit(w) : EXIT_FAILURE;
+	double committed = now();
+	ini_writer_close(w);
+
+	/* the same result the old way, without the comments. */
+	double regen_start = now();
+	f = fopen(BENCH_FILE ".full", "w");
+	for (size_t i = 0; f != NULL && i < sections; i++) {
+		fprintf(f, "[host_%zu]\n", i);
+		fprintf(f, "address = 10.%zu.%zu.%zu\n", i >> 16 & 255, i >> 8 & 255, i & 255);
+		fprintf(f, "enabled = %s\nport = 8080\ntimeout = 30\n\n",
+			i % 100 == 0 ? "false" : "true");
+	}
+	if (f != NULL) {
+		fflush(f);
+		fsync(fileno(f));
+		fclose(f);
+	}
+	double regen = now() - regen_start;
+	remove(BENCH_FILE ".full");
+
+	printf("%zu sections, %zu changes, commit %s\n", sections, changes,
+		status == EXIT_SUCCESS ? "ok" : "FAILED");
+	printf("open and parse %8.3f ms\n", (opened - start) * 1e3);
+	printf("edits          %8.3f ms\n", (edited - opened) * 1e3);
+	printf("commit         %8.3f ms\n", (committed - edited) * 1e3);
+	printf("fprintf all    %8.3f ms\n", regen * 1e3);
+	remove(BENCH_FILE);
+}
+
+/*
+ * test driver.
+ *
+ * testwrite file [commit] edit...
+ * testwrite bench [sections]
+ *
+ * apply the edits as one batch and print the edited file, or with
+ * commit replace the file and print it as read back.
+ *
+ *   testwrite tests/test_write.ini server:port=8081 -server:debug
+ */
+
+int
+main(
+	int argc,
+	char **argv
+) {
+	printf("\n");
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 100000);
+		return EXIT_SUCCESS;
+	}
+	if (argc < 2) {
+		printf("error no file name given\n");
+		return EXIT_FAILURE;
+	}
+	ini_writer *w = ini_writer_open(argv[1]);
+	if (w == NULL) {
+		printf("error could not open or parse %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	bool commit = argc > 2 && strcmp(argv[2], "commit") == 0;
+	for (int i = commit ? 3 : 2; i < argc; i++) {
+		if (apply_edit(w, argv[i]) != EXIT_SUCCESS)
+			printf("edit %d refused\n", i);
+	}
+	printf("%zu lines changed\n", ini_writer_changes(w));
+	fflush(stdout);
+
+	int status;
+	if (commit) {
+		status = ini_writer_commit(w);
+		if (status == EXIT_SUCCESS) {
+			printf("committed, %zu lines pending\n", ini_writer_changes(w));
+			fflush(stdout);
+			status = ini_writer_write(w, STDOUT_FILENO);
+		}
+	} else
+		status = ini_writer_write(w, STDOUT_FILENO);
+	ini_writer_close(w);
+	if (status != EXIT_SUCCESS)
+		printf("write failed\n");
+	return status;
+}
+
+/* testwrite.c ends here */